@@ -0,0 +1,79 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 Bastille Networks.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_LORA_CHANNELIZER_H
+#define INCLUDED_LORA_CHANNELIZER_H
+
+#include <lora/api.h>
+#include <gnuradio/hier_block2.h>
+
+namespace gr {
+  namespace lora {
+
+    /*!
+     * \brief Splits one wideband IQ stream into num_channels LoRa channels and demodulates each
+     * \ingroup lora
+     *
+     * The input is sampled at num_channels times the LoRa bandwidth.  A polyphase
+     * filterbank channelizer decimates it into num_channels adjacent channels of one
+     * sample per chip; channel 0 is centered at DC, channel k at k*bandwidth, with the
+     * upper half of the channels wrapping to negative frequencies.  Each channel feeds
+     * its own lora::demod, which the scheduler runs in its own thread.
+     *
+     * PDUs from every channel are published on a single "out" port; each PDU's
+     * metadata carries a "channel" entry with the index of the channel it came from.
+     *
+     * batch_sync, soft_decoding and header are passed to every lora::demod.  With
+     * oversampling greater than 1 the filterbank outputs that many samples per chip,
+     * and each demodulator filters and decimates them; num_channels must be a
+     * multiple of oversampling.  The demodulators' per-symbol "stream" output is
+     * not exposed: a streaming decoder follows one packet at a time and cannot
+     * separate the channels' interleaved symbols.
+     */
+    class LORA_API channelizer : virtual public gr::hier_block2
+    {
+     public:
+      typedef boost::shared_ptr<channelizer> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of lora::channelizer.
+       *
+       * To avoid accidental use of raw pointers, lora::channelizer's
+       * constructor is in a private implementation
+       * class. lora::channelizer::make is the public interface for
+       * creating new instances.
+       */
+      static sptr make( unsigned short num_channels,
+                        unsigned short spreading_factor,
+                        bool  low_data_rate,
+                        float beta,
+                        unsigned short fft_factor,
+                        bool  batch_sync = false,
+                        unsigned short oversampling = 1,
+                        bool  soft_decoding = false,
+                        bool  header = false);
+    };
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_CHANNELIZER_H */
+
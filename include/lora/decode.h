@@ -52,7 +52,25 @@ namespace gr {
       static sptr make( short spreading_factor,
                         short code_rate,
                         bool  low_data_rate,
-                        bool  header);
+                        bool  header,
+                        bool  crc = false,
+                        short payload_length = 0);
+
+      /*!
+       * \brief Number of frames whose payload CRC-16 matched.
+       *
+       * Only frames decoded from the "in" port are counted.  The stream
+       * path reports its verdict on the "end" marker without counting,
+       * so a packet fed to both ports is counted once.
+       */
+      virtual unsigned long crc_pass_count() const = 0;
+
+      /*!
+       * \brief Number of frames dropped because their payload CRC-16 did not match.
+       *
+       * Counted on the same frames as crc_pass_count().
+       */
+      virtual unsigned long crc_fail_count() const = 0;
     };
 
   } // namespace lora
@@ -66,7 +66,12 @@ namespace gr {
       static sptr make( unsigned short spreading_factor,
                         bool  low_data_rate,
                         float beta,
-                        unsigned short fft_factor);
+                        unsigned short fft_factor,
+                        bool  batch_sync = false,
+                        unsigned short oversampling = 1,
+                        bool  soft_decoding = false,
+                        bool  header = false,
+                        bool  stream = false);
     };
 
   } // namespace lora
@@ -50,7 +50,8 @@ namespace gr {
       static sptr make( short spreading_factor,
                         short code_rate,
                         bool  low_data_rate,
-                        bool  header);
+                        bool  header,
+                        bool  crc = false);
     };
 
   } // namespace lora
@@ -0,0 +1,74 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 Bastille Networks.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_LORA_MULTI_SF_DEMOD_H
+#define INCLUDED_LORA_MULTI_SF_DEMOD_H
+
+#include <lora/api.h>
+#include <gnuradio/hier_block2.h>
+
+namespace gr {
+  namespace lora {
+
+    /*!
+     * \brief Demodulates every spreading factor in [min_sf:max_sf] from one IQ stream
+     * \ingroup lora
+     *
+     * One lora::demod per spreading factor reads the shared input buffer and runs
+     * its own preamble detector in its own thread.  PDUs from all of them are
+     * published on a single "out" port; each PDU's metadata carries an "sf" entry
+     * identifying the spreading factor that matched.  Their per-symbol output is
+     * merged the same way onto a "stream" port.
+     *
+     * batch_sync, oversampling, soft_decoding, header and stream are passed to
+     * every lora::demod.  Explicit headers are not used at SF6, so header
+     * requires min_sf > 6.
+     */
+    class LORA_API multi_sf_demod : virtual public gr::hier_block2
+    {
+     public:
+      typedef boost::shared_ptr<multi_sf_demod> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of lora::multi_sf_demod.
+       *
+       * To avoid accidental use of raw pointers, lora::multi_sf_demod's
+       * constructor is in a private implementation
+       * class. lora::multi_sf_demod::make is the public interface for
+       * creating new instances.
+       */
+      static sptr make( unsigned short min_sf,
+                        unsigned short max_sf,
+                        bool  low_data_rate,
+                        float beta,
+                        unsigned short fft_factor,
+                        bool  batch_sync = false,
+                        unsigned short oversampling = 1,
+                        bool  soft_decoding = false,
+                        bool  header = false,
+                        bool  stream = false);
+    };
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_MULTI_SF_DEMOD_H */
+
@@ -0,0 +1,293 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Throughput of the demod/decode kernels against the implementations they
+ * replaced.  Built next to test-lora but not registered with ctest: timings
+ * depend on the machine, so only the outputs are checked, and the program
+ * exits non-zero if a kernel disagrees with its reference.
+ */
+
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/fft/window.h>
+#include <gnuradio/top_block.h>
+#include <gnuradio/blocks/vector_source_c.h>
+#include <gnuradio/blocks/head.h>
+#include <lora/channelizer.h>
+#include <volk/volk.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include "hamming.h"
+#include "deinterleaver.h"
+#include "fft_peak.h"
+#include "dechirp.h"
+#include "reference_kernels.h"
+
+#define BENCHMARK_CODEWORDS (1 << 24)
+#define BENCHMARK_BLOCKS    (1 << 18)
+#define BENCHMARK_SAMPLES   (1 << 24)
+#define DECHIRP_OFFSETS     16        // OVERLAP_FACTOR in demod_impl.cc
+#define WINDOW_BETA         25.0      // Default demod FFT window beta
+#define MAX_CHANNELS        8
+
+using namespace gr;
+using namespace gr::lora;
+
+typedef std::complex<float> sample_t;
+
+// Millions of items per second
+static double
+mrate(double items, high_res_timer_type ticks)
+{
+  return items*high_res_timer_tps()/std::max(ticks, (high_res_timer_type)1)/1e6;
+}
+
+static void
+random_samples(std::vector<sample_t> &samples)
+{
+  for (size_t i = 0; i < samples.size(); i++)
+  {
+    samples[i] = sample_t(rand()/(float)RAND_MAX - 0.5f, rand()/(float)RAND_MAX - 0.5f);
+  }
+}
+
+static bool
+benchmark_hamming()
+{
+  std::vector<unsigned char> codewords(BENCHMARK_CODEWORDS);
+  std::vector<unsigned char> table_out(BENCHMARK_CODEWORDS);
+  std::vector<unsigned char> reference_out(BENCHMARK_CODEWORDS);
+  unsigned char table[256];
+  bool ok = true;
+
+  for (int rdd = 1; rdd <= 4; rdd++)
+  {
+    hamming_build_table(table, rdd);
+
+    for (size_t i = 0; i < codewords.size(); i++) codewords[i] = rand() & ((1 << (4+rdd)) - 1);
+
+    high_res_timer_type start = high_res_timer_now();
+    for (size_t i = 0; i < codewords.size(); i++)
+    {
+      table_out[i] = table[codewords[i]] & 0x0F;
+    }
+    high_res_timer_type table_ticks = high_res_timer_now() - start;
+
+    start = high_res_timer_now();
+    for (size_t i = 0; i < codewords.size(); i++)
+    {
+      reference_out[i] = reference_decode(codewords[i], rdd);
+    }
+    high_res_timer_type reference_ticks = high_res_timer_now() - start;
+
+    ok &= (table_out == reference_out);
+
+    std::cout << "hamming decode rdd " << rdd << ": "
+              << mrate(codewords.size(), table_ticks)     << " Mcodewords/s (table), "
+              << mrate(codewords.size(), reference_ticks) << " Mcodewords/s (bit loop)" << std::endl;
+  }
+
+  return ok;
+}
+
+static bool
+benchmark_deinterleaver()
+{
+  unsigned char block[INTERLEAVER_BLOCK_SIZE];
+  bool ok = true;
+
+  for (int ppm = 4; ppm <= 12; ppm++)
+  {
+    for (int rdd = 1; rdd <= 4; rdd++)
+    {
+      std::vector<unsigned short> symbols(BENCHMARK_BLOCKS*(4+rdd));
+      unsigned int transpose_sum = 0, reference_sum = 0;
+
+      for (size_t i = 0; i < symbols.size(); i++) symbols[i] = rand() & ((1 << ppm) - 1);
+
+      high_res_timer_type start = high_res_timer_now();
+      for (size_t b = 0; b < BENCHMARK_BLOCKS; b++)
+      {
+        deinterleave_block(&symbols[b*(4+rdd)], ppm, rdd, block);
+        transpose_sum += block[b % ppm];
+      }
+      high_res_timer_type transpose_ticks = high_res_timer_now() - start;
+
+      start = high_res_timer_now();
+      for (size_t b = 0; b < BENCHMARK_BLOCKS; b++)
+      {
+        reference_block(&symbols[b*(4+rdd)], ppm, rdd, block);
+        reference_sum += block[b % ppm];
+      }
+      high_res_timer_type reference_ticks = high_res_timer_now() - start;
+
+      ok &= (transpose_sum == reference_sum);
+
+      std::cout << "deinterleave ppm " << ppm << " rdd " << rdd << ": "
+                << mrate(symbols.size(), transpose_ticks) << " Msymbols/s (transpose), "
+                << mrate(symbols.size(), reference_ticks) << " Msymbols/s (bit loop)" << std::endl;
+    }
+  }
+
+  return ok;
+}
+
+static bool
+benchmark_fft_peak()
+{
+  bool ok = true;
+
+  for (int sf = 6; sf <= 12; sf++)
+  {
+    size_t n = 1 << sf;
+    size_t num_symbols = BENCHMARK_SAMPLES/n;
+    std::vector<sample_t> fft_result(n);
+    std::vector<float>    mag(n);
+    float    peak, total_power;
+    unsigned long volk_sum = 0, reference_sum = 0;
+
+    random_samples(fft_result);
+    fft_result[rand() % n] *= 8.0f;
+
+    high_res_timer_type start = high_res_timer_now();
+    for (size_t s = 0; s < num_symbols; s++)
+    {
+      volk_sum += fft_peak(&fft_result[0], &mag[0], n, total_power);
+    }
+    high_res_timer_type volk_ticks = high_res_timer_now() - start;
+
+    start = high_res_timer_now();
+    for (size_t s = 0; s < num_symbols; s++)
+    {
+      reference_sum += reference_argmax(&fft_result[0], n, peak);
+    }
+    high_res_timer_type reference_ticks = high_res_timer_now() - start;
+
+    ok &= (volk_sum == reference_sum);
+
+    std::cout << "argmax sf " << sf << ": "
+              << mrate(num_symbols*n, volk_ticks)      << " Mbins/s (VOLK), "
+              << mrate(num_symbols*n, reference_ticks) << " Mbins/s (scalar pow)" << std::endl;
+  }
+
+  return ok;
+}
+
+static bool
+benchmark_dechirp()
+{
+  bool ok = true;
+
+  for (int sf = 6; sf <= 12; sf++)
+  {
+    unsigned int n = 1 << sf;
+    size_t num_symbols = BENCHMARK_SAMPLES/n;
+    std::vector<sample_t> upchirp, downchirp;
+    std::vector<float>    window = fft::window::build(fft::window::WIN_KAISER, n, WINDOW_BETA);
+    std::vector<sample_t> tables(DECHIRP_OFFSETS*n);
+    std::vector<sample_t> in(BENCHMARK_SAMPLES), dechirped(n), out(n);
+    sample_t fused_sum = 0, two_pass_sum = 0;
+
+    build_chirps(n, upchirp, downchirp);
+    build_windowed_downchirps(&downchirp[0], &window[0], n, DECHIRP_OFFSETS, &tables[0]);
+    random_samples(in);
+
+    high_res_timer_type start = high_res_timer_now();
+    for (size_t s = 0; s < num_symbols; s++)
+    {
+      unsigned int ol = s % DECHIRP_OFFSETS;
+      volk_32fc_x2_multiply_32fc(&out[0], &in[s*n], &tables[ol*n], n);
+      fused_sum += out[s % n];
+    }
+    high_res_timer_type fused_ticks = high_res_timer_now() - start;
+
+    start = high_res_timer_now();
+    for (size_t s = 0; s < num_symbols; s++)
+    {
+      unsigned int ol = s % DECHIRP_OFFSETS;
+      volk_32fc_x2_multiply_32fc(&dechirped[0], &in[s*n], &downchirp[(ol*n)/DECHIRP_OFFSETS], n);
+      volk_32fc_32f_multiply_32fc(&out[0], &dechirped[0], &window[0], n);
+      two_pass_sum += out[s % n];
+    }
+    high_res_timer_type two_pass_ticks = high_res_timer_now() - start;
+
+    ok &= (std::abs(fused_sum - two_pass_sum) < 1e-3);
+
+    std::cout << "dechirp sf " << sf << ": "
+              << mrate(num_symbols*n, fused_ticks)    << " Msamples/s (windowed table), "
+              << mrate(num_symbols*n, two_pass_ticks) << " Msamples/s (dechirp then window)" << std::endl;
+  }
+
+  return ok;
+}
+
+static bool
+benchmark_channelizer()
+{
+  std::vector<gr_complex> noise(1 << 16);
+  bool ok = true;
+
+  random_samples(noise);
+
+  for (unsigned short num_channels = 1; num_channels <= MAX_CHANNELS; num_channels *= 2)
+  {
+    top_block_sptr                tb   = make_top_block("benchmark_channelizer");
+    blocks::vector_source_c::sptr src  = blocks::vector_source_c::make(noise, true);
+    blocks::head::sptr            head = blocks::head::make(sizeof(gr_complex), BENCHMARK_SAMPLES);
+    channelizer::sptr             chan = channelizer::make(num_channels, 8, false, 25.0, 2);
+
+    tb->connect(src, 0, head, 0);
+    tb->connect(head, 0, chan, 0);
+
+    high_res_timer_type start = high_res_timer_now();
+    tb->run();
+    high_res_timer_type ticks = high_res_timer_now() - start;
+
+    ok &= (head->nitems_read(0) == BENCHMARK_SAMPLES);
+
+    std::cout << "channelizer " << num_channels << " channels: "
+              << mrate(BENCHMARK_SAMPLES, ticks) << " Msamples/s aggregate" << std::endl;
+  }
+
+  return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+  bool ok = true;
+
+  srand(0);
+  ok &= benchmark_hamming();
+  ok &= benchmark_deinterleaver();
+  ok &= benchmark_fft_peak();
+  ok &= benchmark_dechirp();
+  ok &= benchmark_channelizer();
+
+  if (!ok)
+  {
+    std::cerr << "benchmark-lora: a kernel disagreed with its reference implementation" << std::endl;
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_BIT_TRANSPOSE_H
+#define INCLUDED_LORA_BIT_TRANSPOSE_H
+
+#include <stdint.h>
+
+#define INTERLEAVER_BLOCK_SIZE 12   // Codewords per interleaver block at most, one per symbol bit
+
+namespace gr {
+  namespace lora {
+
+    /*
+     * Word-parallel helpers for the diagonal (de)interleavers.
+     *
+     * An interleaver block is at most 8 rows (4+rdd codeword bits) by 12 columns
+     * (ppm symbol bits), so it is handled as two 8x8 bit matrices packed one row
+     * per byte into a 64-bit word.
+     */
+
+    // Transposes an 8x8 bit matrix held one row per byte: bit j of byte i moves to bit i of byte j
+    inline uint64_t
+    transpose_8x8(uint64_t x)
+    {
+      uint64_t t;
+
+      t = (x ^ (x >>  7)) & 0x00AA00AA00AA00AAULL;
+      x = x ^ t ^ (t <<  7);
+      t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+      x = x ^ t ^ (t << 14);
+      t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+      x = x ^ t ^ (t << 28);
+
+      return x;
+    }
+
+    // Rotates the low width bits of value left by shift
+    inline unsigned short
+    rotate_left(unsigned short value, unsigned int shift, unsigned char width)
+    {
+      const unsigned short mask = (1 << width) - 1;
+
+      shift %= width;
+      value &= mask;
+      return ((value << shift) | (value >> (width - shift))) & mask;
+    }
+
+    // Rotates the low width bits of value right by shift
+    inline unsigned short
+    rotate_right(unsigned short value, unsigned int shift, unsigned char width)
+    {
+      return rotate_left(value, width - (shift % width), width);
+    }
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_BIT_TRANSPOSE_H */
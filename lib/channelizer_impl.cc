@@ -0,0 +1,139 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 Bastille Networks.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include <gnuradio/filter/firdes.h>
+#include "channelizer_impl.h"
+#include "pdu_keys.h"
+
+#define CHANNELIZER_CUTOFF       0.5    // Channel edge, in units of the LoRa bandwidth
+#define CHANNELIZER_TRANSITION   0.2    // MAGIC -- trades adjacent channel rejection against prototype filter length
+#define CHANNELIZER_ATTENUATION  60.0   // Stopband attenuation of the prototype filter, in dB
+
+namespace gr {
+  namespace lora {
+
+    channelizer::sptr
+    channelizer::make(  unsigned short num_channels,
+                        unsigned short spreading_factor,
+                        bool  low_data_rate,
+                        float beta,
+                        unsigned short fft_factor,
+                        bool  batch_sync,
+                        unsigned short oversampling,
+                        bool  soft_decoding,
+                        bool  header)
+    {
+      return gnuradio::get_initial_sptr
+        (new channelizer_impl(num_channels, spreading_factor, low_data_rate, beta, fft_factor, batch_sync, oversampling, soft_decoding, header));
+    }
+
+    /*
+     * The private constructor
+     */
+    channelizer_impl::channelizer_impl( unsigned short num_channels,
+                                        unsigned short spreading_factor,
+                                        bool  low_data_rate,
+                                        float beta,
+                                        unsigned short fft_factor,
+                                        bool  batch_sync,
+                                        unsigned short oversampling,
+                                        bool  soft_decoding,
+                                        bool  header)
+      : gr::hier_block2("channelizer",
+              gr::io_signature::make(1, 1, sizeof(gr_complex)),
+              gr::io_signature::make(0, 0, 0))
+    {
+      assert(num_channels > 0);
+      assert((oversampling > 0) && (num_channels % oversampling == 0));   // The filterbank's output rate must divide its input rate
+
+      d_out_port = pmt::mp("out");
+      message_port_register_hier_out(d_out_port);
+
+      // Prototype lowpass is designed at the wideband rate, normalized to one LoRa bandwidth per channel
+      std::vector<float> taps = filter::firdes::low_pass_2(1.0, num_channels,
+                                                           CHANNELIZER_CUTOFF, CHANNELIZER_TRANSITION,
+                                                           CHANNELIZER_ATTENUATION);
+
+      // The polyphase filterbank takes one input per branch, so commutate the wideband stream across them first
+      d_deinterleave = blocks::stream_to_streams::make(sizeof(gr_complex), num_channels);
+      d_pfb          = filter::pfb_channelizer_ccf::make(num_channels, taps, oversampling);
+
+      connect(self(), 0, d_deinterleave, 0);
+      for (unsigned short ch = 0; ch < num_channels; ch++)
+      {
+        connect(d_deinterleave, ch, d_pfb, ch);
+      }
+
+      // Each channel gets its own demodulator, run in its own scheduler thread
+      for (unsigned short ch = 0; ch < num_channels; ch++)
+      {
+        demod::sptr          demod_ch  = demod::make(spreading_factor, low_data_rate, beta, fft_factor, batch_sync, oversampling, soft_decoding, header);
+        channel_tagger::sptr tagger_ch = gnuradio::get_initial_sptr(new channel_tagger(ch));
+
+        connect(d_pfb, ch, demod_ch, 0);
+        msg_connect(demod_ch,  pmt::mp("out"), tagger_ch, pmt::mp("in"));
+        msg_connect(tagger_ch, pmt::mp("out"), self(),    d_out_port);
+
+        d_demods.push_back(demod_ch);
+        d_taggers.push_back(tagger_ch);
+      }
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    channelizer_impl::~channelizer_impl()
+    {
+    }
+
+    channel_tagger::channel_tagger(unsigned short channel)
+      : gr::block("channel_tagger",
+              gr::io_signature::make(0, 0, 0),
+              gr::io_signature::make(0, 0, 0)),
+        d_channel(pmt::from_long(channel))
+    {
+      d_in_port  = pmt::mp("in");
+      d_out_port = pmt::mp("out");
+
+      message_port_register_in(d_in_port);
+      message_port_register_out(d_out_port);
+
+      set_msg_handler(d_in_port, boost::bind(&channel_tagger::tag, this, _1));
+    }
+
+    channel_tagger::~channel_tagger()
+    {
+    }
+
+    void
+    channel_tagger::tag(pmt::pmt_t msg)
+    {
+      pmt::pmt_t meta = pmt::dict_add(pmt::car(msg), PDU_KEY_CHANNEL, d_channel);
+      message_port_pub(d_out_port, pmt::cons(meta, pmt::cdr(msg)));
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
+
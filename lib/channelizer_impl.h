@@ -0,0 +1,80 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 Bastille Networks.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_CHANNELIZER_IMPL_H
+#define INCLUDED_LORA_CHANNELIZER_IMPL_H
+
+#include <vector>
+#include <gnuradio/block.h>
+#include <gnuradio/blocks/stream_to_streams.h>
+#include <gnuradio/filter/pfb_channelizer_ccf.h>
+#include <lora/channelizer.h>
+#include <lora/demod.h>
+
+namespace gr {
+  namespace lora {
+
+    /*
+     * Adds the index of the channel a PDU was received on to the PDU's metadata
+     */
+    class channel_tagger : public gr::block
+    {
+     private:
+      pmt::pmt_t d_in_port;
+      pmt::pmt_t d_out_port;
+      pmt::pmt_t d_channel;
+
+     public:
+      typedef boost::shared_ptr<channel_tagger> sptr;
+
+      channel_tagger(unsigned short channel);
+      ~channel_tagger();
+
+      void tag(pmt::pmt_t msg);
+    };
+
+    class channelizer_impl : public channelizer
+    {
+     private:
+      pmt::pmt_t d_out_port;
+
+      blocks::stream_to_streams::sptr    d_deinterleave;
+      filter::pfb_channelizer_ccf::sptr  d_pfb;
+      std::vector<demod::sptr>           d_demods;
+      std::vector<channel_tagger::sptr>  d_taggers;
+
+     public:
+      channelizer_impl( unsigned short num_channels,
+                        unsigned short spreading_factor,
+                        bool  low_data_rate,
+                        float beta,
+                        unsigned short fft_factor,
+                        bool  batch_sync,
+                        unsigned short oversampling,
+                        bool  soft_decoding,
+                        bool  header);
+      ~channelizer_impl();
+    };
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_CHANNELIZER_IMPL_H */
+
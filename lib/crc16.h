@@ -0,0 +1,55 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_CRC16_H
+#define INCLUDED_LORA_CRC16_H
+
+#define CRC16_POLYNOMIAL  0x1021   // CRC-16/CCITT, x^16 + x^12 + x^5 + 1
+#define CRC16_INITIAL     0x0000
+#define CRC16_BYTES       2        // Sent MSB first, directly after the payload
+
+namespace gr {
+  namespace lora {
+
+    // Fills table with the CRC of every possible leading byte, for byte-at-a-time updates
+    inline void
+    crc16_build_table(unsigned short *table)
+    {
+      for (int byte = 0; byte < 256; byte++)
+      {
+        unsigned short crc = byte << 8;
+        for (int bit = 0; bit < 8; bit++)
+        {
+          crc = (crc & 0x8000) ? (crc << 1) ^ CRC16_POLYNOMIAL : (crc << 1);
+        }
+        table[byte] = crc;
+      }
+    }
+
+    inline unsigned short
+    crc16_update(const unsigned short *table, unsigned short crc, unsigned char byte)
+    {
+      return (crc << 8) ^ table[((crc >> 8) ^ byte) & 0xFF];
+    }
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_CRC16_H */
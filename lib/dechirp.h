@@ -0,0 +1,75 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_LORA_DECHIRP_H
+#define INCLUDED_LORA_DECHIRP_H
+
+#include <complex>
+#include <vector>
+#include <cmath>
+#include <volk/volk.h>
+
+namespace gr {
+  namespace lora {
+
+    // Builds the local chirp tables.  Each table is 2 chirps long to allow reading a chirp from any offset.
+    inline void
+    build_chirps(unsigned int num_symbols,
+                 std::vector<std::complex<float> > &upchirp,
+                 std::vector<std::complex<float> > &downchirp)
+    {
+      float phase = -M_PI;
+      double accumulator = 0;
+
+      upchirp.clear();
+      downchirp.clear();
+
+      for (unsigned int i = 0; i < 2*num_symbols; i++) {
+        accumulator += phase;
+        downchirp.push_back(std::complex<float>(std::conj(std::polar(1.0, accumulator))));
+        upchirp.push_back(std::complex<float>(std::polar(1.0, accumulator)));
+        phase += (2*M_PI)/num_symbols;
+      }
+    }
+
+    // Folds the window into the downchirp at each of num_offsets offsets, num_symbols/num_offsets samples
+    // apart, so that dechirping and windowing a symbol is a single complex multiply.  Table ol starts at
+    // tables[ol*num_symbols].
+    inline void
+    build_windowed_downchirps(const std::complex<float> *downchirp,
+                              const float *window,
+                              unsigned int num_symbols,
+                              unsigned int num_offsets,
+                              std::complex<float> *tables)
+    {
+      for (unsigned int ol = 0; ol < num_offsets; ol++)
+      {
+        volk_32fc_32f_multiply_32fc(&tables[ol*num_symbols],
+                                    &downchirp[(ol*num_symbols)/num_offsets],
+                                    window,
+                                    num_symbols);
+      }
+    }
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_DECHIRP_H */
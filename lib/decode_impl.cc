@@ -23,16 +23,14 @@
 #endif
 
 #include <gnuradio/io_signature.h>
+#include <algorithm>
+#include <limits>
 #include "decode_impl.h"
-
-#define MAXIMUM_RDD 4
-
-#define HAMMING_P1_BITMASK 0xAA  // 0b10101010
-#define HAMMING_P2_BITMASK 0x66  // 0b01100110
-#define HAMMING_P4_BITMASK 0x1E  // 0b00011110
-#define HAMMING_P8_BITMASK 0xFE  // 0b11111110
-
-#define INTERLEAVER_BLOCK_SIZE 12
+#include "deinterleaver.h"
+#include "hamming.h"
+#include "phy_header.h"
+#include "crc16.h"
+#include "pdu_keys.h"
 
 #define DEBUG_OUTPUT 0
 
@@ -43,10 +41,12 @@ namespace gr {
     decode::make(   short spreading_factor,
                     short code_rate,
                     bool  low_data_rate,
-                    bool  header)
+                    bool  header,
+                    bool  crc,
+                    short payload_length)
     {
       return gnuradio::get_initial_sptr
-        (new decode_impl(spreading_factor, code_rate, low_data_rate, header));
+        (new decode_impl(spreading_factor, code_rate, low_data_rate, header, crc, payload_length));
     }
 
     /*
@@ -55,19 +55,30 @@ namespace gr {
     decode_impl::decode_impl( short spreading_factor,
                               short code_rate,
                               bool  low_data_rate,
-                              bool  header)
+                              bool  header,
+                              bool  crc,
+                              short payload_length)
       : gr::block("decode",
               gr::io_signature::make(0, 0, 0),
               gr::io_signature::make(0, 0, 0)),
         d_sf(spreading_factor),
         d_cr(code_rate),
         d_ldr(low_data_rate),
-        d_header(header)
+        d_header(header),
+        d_crc(crc),
+        d_payload_length(payload_length)
     {
       assert((d_sf > 5) && (d_sf < 13));
       assert((d_cr > 0) && (d_cr < 5));
+      assert((payload_length >= 0) && (payload_length < 256));
       if (d_sf == 6) assert(!header);
 
+      // Without an explicit header the CRC can only be located from a configured payload length
+      if (!d_header && d_crc && !d_payload_length)
+      {
+        std::cout << "Warning: Payload CRC in implicit header mode needs the payload length; frames are passed through unchecked." << std::endl;
+      }
+
       d_in_port = pmt::mp("in");
       d_out_port = pmt::mp("out");
 
@@ -76,6 +87,17 @@ namespace gr {
 
       set_msg_handler(d_in_port, boost::bind(&decode_impl::decode, this, _1));
 
+      // Symbol-by-symbol input from the demodulator, decoded one interleaver block at a time
+      d_stream_port  = pmt::mp("stream");
+      d_partial_port = pmt::mp("partial");
+
+      message_port_register_in(d_stream_port);
+      message_port_register_out(d_partial_port);
+
+      set_msg_handler(d_stream_port, boost::bind(&decode_impl::decode_stream, this, _1));
+
+      reset_stream();
+
       switch(d_sf)
       {
         case 6:
@@ -114,13 +136,44 @@ namespace gr {
 
       if (d_header)
       {
-        std::cout << "Warning: Explicit header mode is not yet supported." << std::endl;
-        std::cout << "         Using an implicit whitening sequence: demodulation will work correctly; decoding will not." << std::endl;
+        std::cout << "Warning: No explicit header whitening sequence is known; the payload is de-whitened with the implicit sequence." << std::endl;
       }
 
       d_interleaver_size = d_sf;
 
       d_fft_size = (1 << spreading_factor);
+
+      // Decode every possible raw codeword once, for every code rate
+      for (int rdd = 1; rdd <= MAXIMUM_RDD; rdd++)
+      {
+        hamming_build_table(d_hamming_table[rdd-1], rdd);
+      }
+
+      for (int rdd = 1; rdd <= MAXIMUM_RDD; rdd++)
+      {
+        hamming_build_encode_table(d_soft_codewords[rdd-1], rdd);
+      }
+
+      // Size the scratch buffers for the longest explicit header packet up front
+      size_t max_symbols = phy_packet_symbols(d_sf, 255, MAXIMUM_RDD, true, d_ldr);
+      size_t max_nybbles = 2*(255 + CRC16_BYTES) + PHY_HEADER_SYMBOLS;
+      d_symbols.reserve(max_symbols);
+      d_block.reserve(PHY_HEADER_SYMBOLS);
+      d_codewords.reserve(d_sf);
+      d_bytes.reserve(max_nybbles);
+      d_partial_bytes.reserve(max_nybbles/2);
+      d_frame.reserve(max_nybbles/2);
+      d_header_symbols.reserve(PHY_HEADER_SYMBOLS);
+      d_payload_symbols.reserve(max_symbols);
+      d_header_codewords.reserve(d_sf);
+      d_payload_codewords.reserve(max_nybbles);
+      d_header_nybbles.reserve(max_nybbles);
+      d_payload_nybbles.reserve(max_nybbles);
+      d_frame_bytes.reserve(max_nybbles/2);
+
+      crc16_build_table(d_crc_table);
+      d_crc_pass = 0;
+      d_crc_fail = 0;
     }
 
     /*
@@ -153,221 +206,155 @@ namespace gr {
     }
 
     void
-    decode_impl::whiten(std::vector<unsigned short> &symbols)
+    decode_impl::whiten(std::vector<unsigned short> &symbols, size_t offset)
     {
-      for (int i = 0; (i < symbols.size()) && (i < whitening_sequence_length); i++)
+      // offset is the position of symbols[0] within the packet
+      for (int i = 0; (i < symbols.size()) && (i + offset < whitening_sequence_length); i++)
       {
-        symbols[i] = (symbols[i] ^ d_whitening_sequence[i]);
+        symbols[i] = (symbols[i] ^ d_whitening_sequence[i + offset]);
       }
     }
 
-    // Forward interleaver dimensions:
-    //  PPM   == number of bits per symbol OUT of interleaver        AND number of codewords IN to interleaver
-    //  RDD+4 == number of bits per codeword IN to interleaver       AND number of interleaved codewords OUT of interleaver
-    //
-    // bit width in:  (4+rdd)   block length: ppm
-    // bit width out: ppm       block length: (4+rdd)
+    // Gray decodes and optionally de-whitens num_symbols raw symbols into out, in a single pass
+    // offset is the position of symbols[0] within the packet
+    void
+    decode_impl::gray_whiten(const uint16_t *symbols,
+                             size_t num_symbols,
+                             size_t offset,
+                             bool whitened,
+                             std::vector<unsigned short> &out)
+    {
+      out.clear();
+      for (size_t i = 0; i < num_symbols; i++)
+      {
+        unsigned short symbol = (symbols[i] >> 1) ^ symbols[i];
+        if (whitened && (i + offset < whitening_sequence_length)) symbol ^= d_whitening_sequence[i + offset];
+        out.push_back(symbol);
+      }
+    }
 
-    // Reverse interleaver (de-interleaver) dimensions:
-    //  PPM   == number of bits per symbol IN to deinterleaver       AND number of codewords OUT of deinterleaver
-    //  RDD+4 == number of bits per codeword OUT of deinterleaver    AND number of interleaved codewords IN to deinterleaver
-    //
-    // bit width in:  ppm       block length: (4+rdd)
-    // bit width out: (4+rdd)   block length: ppm
+    // Block interleaver: de-interleave RDD+4 symbols at a time into PPM codewords, appended to codewords
+    // See deinterleaver.h for the block dimensions and the word-parallel transpose
     void
-    decode_impl::deinterleave(std::vector <unsigned short> &symbols,
+    decode_impl::deinterleave(const std::vector <unsigned short> &symbols,
                               std::vector <unsigned char> &codewords,
                               unsigned char ppm,
                               unsigned char rdd)
     {
-      int symbol_offset = 0;
-      int bit_offset    = 0;
-      int bit_idx       = 0;
-      unsigned char block[INTERLEAVER_BLOCK_SIZE];    // maximum bit-width is 8, should RDD==4
-
-      // Swap MSBs of each symbol within buffer (one of LoRa's quirks)
-      for (int symbol_idx = 0; symbol_idx < symbols.size(); symbol_idx++)
-      {
-        symbols[symbol_idx] = ( (symbols[symbol_idx] &  (0x1 << (ppm-1))) >> 1 |
-                                (symbols[symbol_idx] &  (0x1 << (ppm-2))) << 1 |
-                                (symbols[symbol_idx] & ((0x1 << (ppm-2)) - 1))
-                              );
-      }
-
-      // Block interleaver: de-interleave RDD+4 symbols at a time into PPM codewords
-      for (int block_count = 0; block_count < symbols.size()/(4+rdd); block_count++)
-      {
-        memset(block, 0, INTERLEAVER_BLOCK_SIZE*sizeof(unsigned char));
-        bit_idx = 0;
-        bit_offset = 0;
+      size_t num_blocks = symbols.size()/(4+rdd);
+      size_t offset     = codewords.size();
 
-        // Iterate through each bit in the interleaver block
-        for (int bitcount = 0; bitcount < ppm*(4+rdd); bitcount++)
-        {
-              // Symbol indexing                                     // Diagonal pattern mask
-          if (symbols[(bitcount % (4+rdd)) + (4+rdd)*block_count] & ((0x1 << (ppm-1)) >> ((bit_idx + bit_offset) % ppm)))
-          {
-            block[bitcount / (4+rdd)] |= 0x1 << (bitcount % (4+rdd));   // integer divison in C++ is defined to floor
-          }
+      if (num_blocks == 0) return;
 
-          // bit_idx walks through diagonal interleaving pattern, bit_offset adjusts offset starting point for each codeword
-          if (bitcount % (4+rdd) == (4+rdd-1))
-          {
-            bit_idx = 0;
-            bit_offset++;
-          }
-          else
-          {
-            bit_idx++;
-          }
-        }
-
-        // Post-process de-interleaved codewords
-        for (int cw_idx = 0; cw_idx < ppm; cw_idx++)
-        {
-          // Put bits into traditional Hamming order
-          switch (rdd)
-          {
-            case 4:
-              block[cw_idx] = (block[cw_idx] & 128) | (block[cw_idx] & 64) | (block[cw_idx] & 32) >> 5 | (block[cw_idx] & 16) | (block[cw_idx] & 8) << 2 | (block[cw_idx] & 4) << 1 | (block[cw_idx] & 2) << 1 | (block[cw_idx] & 1) << 1;
-              break;
-
-            case 3:
-              block[cw_idx] = (block[cw_idx] & 64) | (block[cw_idx] & 32) | (block[cw_idx] & 16) >> 1 | (block[cw_idx] & 8) << 1 | (block[cw_idx] & 4) | (block[cw_idx] & 2) | (block[cw_idx] & 1);
-              break;
-
-            default:
-              break;
-          }
-
-          // Mask
-          block[cw_idx] = block[cw_idx] & ((1 << (4+rdd)) - 1);
-        }
-        
-        // Append deinterleaved codewords to codeword buffer, rearranging into proper order
-        if (ppm == 8)
-        {
-          codewords.push_back(block[6]);
-          codewords.push_back(block[7]);
-          codewords.push_back(block[4]);
-          codewords.push_back(block[5]);
-        }
-        else if (ppm == 7)
-        {
-          codewords.push_back(block[6]);
-          codewords.push_back(block[4]);
-          codewords.push_back(block[5]);
-        }
-        else if (ppm == 6)
-        {
-          codewords.push_back(block[4]);
-          codewords.push_back(block[5]);
-        }
-        else if (ppm == 5)
-        {
-          codewords.push_back(block[4]);
-        }
-        codewords.push_back(block[2]);
-        codewords.push_back(block[3]);
-        codewords.push_back(block[0]);
-        codewords.push_back(block[1]);
-      }
+      codewords.resize(offset + num_blocks*ppm);
+      deinterleave_codewords(&symbols[0], symbols.size(), ppm, rdd, &codewords[offset]);
     }
 
-
-
     void
     decode_impl::hamming_decode(std::vector<unsigned char> &codewords,
                                 std::vector<unsigned char> &bytes,
                                 unsigned char rdd)
     {
-      unsigned char p1, p2, p4, p8;
-      unsigned char mask;
-      unsigned int num_set_bits;
-      unsigned int num_set_flags;
-      int error_pos = 0;
+      const unsigned char *table = d_hamming_table[rdd-1];
 
       for (int i = 0; i < codewords.size(); i++)
       {
-        switch (rdd) {
-          case 4:
-            p8 = parity(codewords[i], mask = (unsigned char)HAMMING_P8_BITMASK);
-          case 3:
-            p4 = parity(codewords[i], mask = (unsigned char)HAMMING_P4_BITMASK >> (4 - rdd));
-          case 2:
-            p2 = parity(codewords[i], mask = (unsigned char)HAMMING_P2_BITMASK >> (4 - rdd));
-          case 1:
-            p1 = parity(codewords[i], mask = (unsigned char)HAMMING_P1_BITMASK >> (4 - rdd));
-            break;
-        }
-
-        error_pos = -1;
-        if (p1 != 0) error_pos += 1;
-        if (p2 != 0) error_pos += 2;
-        if (p4 != 0) error_pos += 4;
+        bytes.push_back(table[codewords[i]] & 0x0F);
+      }
+    }
 
-        num_set_flags = p1 + p2 + p4;
+    // Soft-decision counterpart of deinterleave() followed by hamming_decode()
+    //
+    // Each symbol comes with its num_candidates strongest values and their bin powers.  Every
+    // candidate goes through the same gray/whitening/MSB swap mapping as a hard symbol, and each
+    // bit's log-likelihood ratio is the max-log difference between the strongest candidate with
+    // that bit clear and the strongest with it set.  Values outside the candidate list are no
+    // stronger than the weakest candidate, so that bounds either side.  Codewords are then decoded
+    // to the nybble whose valid codeword best agrees with the deinterleaved LLRs.
+    void
+    decode_impl::soft_decode(const uint16_t *candidates,
+                             const float *magnitudes,
+                             const float *noise,
+                             size_t num_candidates,
+                             size_t first_symbol,
+                             size_t num_symbols,
+                             unsigned char ppm,
+                             unsigned char rdd,
+                             bool whitened,
+                             std::vector<unsigned char> &nybbles)
+    {
+      float llr[INTERLEAVER_BLOCK_SIZE][INTERLEAVER_BLOCK_SIZE];   // [symbol within block][bit]
+      float best_clear[INTERLEAVER_BLOCK_SIZE];
+      float best_set[INTERLEAVER_BLOCK_SIZE];
+      unsigned char order[INTERLEAVER_BLOCK_SIZE];
+      int num_ordered = 0;
+
+      // Codeword output order, as in deinterleave()
+      if (ppm % 2) order[num_ordered++] = ppm-1;
+      for (int cw_idx = (ppm & ~0x1) - 2; cw_idx >= 0; cw_idx -= 2)
+      {
+        order[num_ordered++] = cw_idx;
+        order[num_ordered++] = cw_idx+1;
+      }
 
-        // Hamming(4+rdd,4) is only corrective if rdd >= 3
-        if (rdd > 2)
+      for (size_t block_start = 0; block_start + (4+rdd) <= num_symbols; block_start += (4+rdd))
+      {
+        for (int s = 0; s < (4+rdd); s++)
         {
-          num_set_bits = 0;
-          for (int bit_idx = 0; bit_idx < 8; bit_idx++)
+          size_t symbol_idx = first_symbol + block_start + s;
+          const uint16_t *cand = &candidates[symbol_idx*num_candidates];
+          const float    *mag  = &magnitudes[symbol_idx*num_candidates];
+          float scale = (noise[symbol_idx] > 0) ? 1.0f/noise[symbol_idx] : 1.0f;
+
+          std::fill(best_clear, best_clear + ppm, mag[num_candidates-1]*scale);
+          std::fill(best_set,   best_set   + ppm, mag[num_candidates-1]*scale);
+
+          for (size_t k = 0; k < num_candidates; k++)
           {
-            if (codewords[i] & (0x01 << bit_idx))
+            unsigned short value = cand[k];
+            value = (value >> 1) ^ value;
+            if (whitened && symbol_idx < whitening_sequence_length) value ^= d_whitening_sequence[symbol_idx];
+            value = ( (value &  (0x1 << (ppm-1))) >> 1 |
+                      (value &  (0x1 << (ppm-2))) << 1 |
+                      (value & ((0x1 << (ppm-2)) - 1)) );
+
+            for (int bit = 0; bit < ppm; bit++)
             {
-              num_set_bits++;
+              float *best = (value & (0x1 << bit)) ? best_set : best_clear;
+              best[bit] = std::max(best[bit], mag[k]*scale);
             }
           }
 
-          if (error_pos >= 0 && num_set_bits < 6 && num_set_bits > 2)
-          {
-            codewords[i] ^= (0x80 >> (4-rdd)) >> error_pos;
-          } 
+          for (int bit = 0; bit < ppm; bit++) llr[s][bit] = best_clear[bit] - best_set[bit];
+        }
+
+        // Bit s of codeword cw is bit (ppm-1-(s+cw)%ppm) of symbol s
+        for (int i = 0; i < ppm; i++)
+        {
+          int   cw         = order[i];
+          int   best_nybble = 0;
+          float best_score  = -std::numeric_limits<float>::infinity();
 
-          num_set_bits = 0;
-          for (int bit_idx = 0; bit_idx < 8; bit_idx++)
+          for (int nybble = 0; nybble < 16; nybble++)
           {
-            if (codewords[i] & (0x01 << bit_idx))
+            unsigned char codeword = d_soft_codewords[rdd-1][nybble];
+            float score = 0;
+
+            for (int s = 0; s < (4+rdd); s++)
             {
-              num_set_bits++;
+              float bit_llr = llr[s][ppm-1-(s+cw)%ppm];
+              score += (codeword & (0x1 << s)) ? -bit_llr : bit_llr;
             }
-          }
 
-          // if (rdd == 4)
-          // {
-          //   if (num_set_bits < 3)
-          //   {
-          //     codewords[i] = 0;
-          //   }
-          //   else if (num_set_bits > 5)
-          //   {
-          //     codewords[i] = 0xFF;
-          //   }
-          // }
-        }
+            if (score > best_score)
+            {
+              best_score  = score;
+              best_nybble = nybble;
+            }
+          }
 
-        switch (rdd)
-        {
-          case 1:
-          case 2:
-            codewords[i] = codewords[i] & 0x0F;
-            break;
-          case 3:
-            codewords[i] = (((codewords[i] & 0x10) >> 1) | \
-                            ((codewords[i] & 0x04))      | \
-                            ((codewords[i] & 0x02))      | \
-                            ((codewords[i] & 0x01))) & 0x0F;
-            break;
-          case 4:
-            codewords[i] = (((codewords[i] & 0x20) >> 2) | \
-                            ((codewords[i] & 0x08) >> 1) | \
-                            ((codewords[i] & 0x04) >> 1) | \
-                            ((codewords[i] & 0x02) >> 1)) & 0x0F;
-            break;
+          nybbles.push_back(best_nybble);
         }
-
-        bytes.push_back(codewords[i] & 0x0F);
       }
     }
 
@@ -420,29 +407,66 @@ namespace gr {
     void
     decode_impl::decode(pmt::pmt_t msg)
     {
+      pmt::pmt_t meta(pmt::car(msg));
       pmt::pmt_t symbols(pmt::cdr(msg));
 
+      // Ignore packets demodulated at a different spreading factor (e.g. from a multi-SF demodulator)
+      if (pmt::is_dict(meta) && (pmt::to_long(pmt::dict_ref(meta, PDU_KEY_SF, pmt::from_long(d_sf))) != d_sf))
+      {
+        return;
+      }
+
+      // Symbols are read in place from the PDU; every intermediate buffer below is member scratch
       size_t pkt_len(0);
       const uint16_t* symbols_v = pmt::u16vector_elements(symbols, pkt_len);
+      size_t header_len = std::min(pkt_len, (size_t)PHY_HEADER_SYMBOLS);
+
+      std::vector<unsigned short> &header_symbols_in  = d_header_symbols;
+      std::vector<unsigned short> &payload_symbols_in = d_payload_symbols;
+      std::vector<unsigned char>  &header_codewords   = d_header_codewords;
+      std::vector<unsigned char>  &payload_codewords  = d_payload_codewords;
+      std::vector<unsigned char>  &header_bytes       = d_header_nybbles;
+      std::vector<unsigned char>  &payload_bytes      = d_payload_nybbles;
+      std::vector<unsigned char>  &combined_bytes     = d_frame_bytes;
+
+      header_codewords.clear();
+      payload_codewords.clear();
+      header_bytes.clear();
+      payload_bytes.clear();
+      combined_bytes.clear();
+
+      unsigned char payload_len = 0;
+      unsigned char cr          = d_cr;
+      bool          crc         = false;
+
+      pmt::pmt_t out_meta = pmt::make_dict();
+
+      // Soft decisions from a demodulator in soft decoding mode, used in place of the hard symbols when present
+      const uint16_t *soft_symbols    = NULL;
+      const float    *soft_magnitudes = NULL;
+      const float    *soft_noise      = NULL;
+      size_t          num_candidates  = 0;
+      bool            soft            = false;
+
+      if (pmt::is_dict(meta) && pmt::dict_has_key(meta, PDU_KEY_SOFT_SYMBOLS))
+      {
+        size_t num_soft_symbols(0), num_soft_magnitudes(0), num_soft_noise(0);
 
-      std::vector<unsigned short> symbols_in;
-      std::vector<unsigned short> header_symbols_in;
-      std::vector<unsigned short> payload_symbols_in;
-      std::vector<unsigned char> header_codewords;
-      std::vector<unsigned char> payload_codewords;
-      std::vector<unsigned char> header_bytes;
-      std::vector<unsigned char> payload_bytes;
-      std::vector<unsigned char> combined_bytes;
+        num_candidates  = pmt::to_long(pmt::dict_ref(meta, PDU_KEY_SOFT_CANDIDATES, pmt::from_long(0)));
+        soft_symbols    = pmt::u16vector_elements(pmt::dict_ref(meta, PDU_KEY_SOFT_SYMBOLS,    pmt::PMT_NIL), num_soft_symbols);
+        soft_magnitudes = pmt::f32vector_elements(pmt::dict_ref(meta, PDU_KEY_SOFT_MAGNITUDES, pmt::PMT_NIL), num_soft_magnitudes);
+        soft_noise      = pmt::f32vector_elements(pmt::dict_ref(meta, PDU_KEY_SOFT_NOISE,      pmt::PMT_NIL), num_soft_noise);
 
-      symbols_in.clear();
-      for (int i = 0; i < pkt_len; i++) symbols_in.push_back(symbols_v[i]);
+        soft = (num_candidates > 0) &&
+               (num_soft_symbols == pkt_len*num_candidates) &&
+               (num_soft_magnitudes == pkt_len*num_candidates) &&
+               (num_soft_noise == pkt_len);
+      }
 
-      to_gray(symbols_in);
 #if 1 // Disable this #if to derive the whitening sequence
-      whiten(symbols_in);
-
-      for (int i = 0; (i < symbols_in.size()) && (i < 8); i++) header_symbols_in.push_back(symbols_in[i]);
-      for (int i = 8;  i < symbols_in.size()            ; i++) payload_symbols_in.push_back(symbols_in[i]);
+      // An explicit header is sent without whitening
+      gray_whiten(symbols_v,              header_len,           0,          !d_header, header_symbols_in);
+      gray_whiten(symbols_v + header_len, pkt_len - header_len, header_len, true,      payload_symbols_in);
 
       #if DEBUG_OUTPUT
         std::cout << "header syms len " << header_symbols_in.size() << std::endl;
@@ -456,23 +480,47 @@ namespace gr {
 
       // Decode header
       // First 8 symbols are always sent at ppm=d_sf-2, rdd=4 (code rate 4/8), regardless of header mode
-      deinterleave(header_symbols_in, header_codewords, d_sf-2, 4);
-      #if DEBUG_OUTPUT
-        std::cout << "deinterleaved header" << std::endl;
-        print_bitwise_u8(header_codewords);
-      #endif
+      if (soft)
+      {
+        soft_decode(soft_symbols, soft_magnitudes, soft_noise, num_candidates, 0, header_symbols_in.size(), d_sf-2, 4, !d_header, header_bytes);
+      }
+      else
+      {
+        deinterleave(header_symbols_in, header_codewords, d_sf-2, 4);
+        #if DEBUG_OUTPUT
+          std::cout << "deinterleaved header" << std::endl;
+          print_bitwise_u8(header_codewords);
+        #endif
 
-      hamming_decode(header_codewords, header_bytes, 4);
+        hamming_decode(header_codewords, header_bytes, 4);
+      }
+
+      // A packet cut off inside the header block decodes to fewer nybbles than the header holds, or none at all
+      if (d_header && (header_bytes.size() < PHY_HEADER_NYBBLES ||
+                       !phy_header_parse(&header_bytes[0], header_bytes.size(), payload_len, cr, crc)))
+      {
+        #if DEBUG_OUTPUT
+          std::cout << "explicit header missing or checksum failed, dropping packet" << std::endl;
+        #endif
+        return;
+      }
 
       // Decode payload
       // Remaining symbols are at ppm=d_sf, unless sent at the low data rate, in which case ppm=d_sf-2
-      deinterleave(payload_symbols_in, payload_codewords, d_ldr ? (d_sf-2) : d_sf, d_cr);
-      #if DEBUG_OUTPUT
-        std::cout << "deinterleaved payload" << std::endl;
-        print_bitwise_u8(payload_codewords);
-      #endif
+      if (soft)
+      {
+        soft_decode(soft_symbols, soft_magnitudes, soft_noise, num_candidates, header_symbols_in.size(), payload_symbols_in.size(), d_ldr ? (d_sf-2) : d_sf, cr, true, payload_bytes);
+      }
+      else
+      {
+        deinterleave(payload_symbols_in, payload_codewords, d_ldr ? (d_sf-2) : d_sf, cr);
+        #if DEBUG_OUTPUT
+          std::cout << "deinterleaved payload" << std::endl;
+          print_bitwise_u8(payload_codewords);
+        #endif
 
-      hamming_decode(payload_codewords, payload_bytes, d_cr);
+        hamming_decode(payload_codewords, payload_bytes, cr);
+      }
       #if DEBUG_OUTPUT
         std::cout << "payload data" << std::endl;
         print_bitwise_u8(payload_bytes);
@@ -480,6 +528,18 @@ namespace gr {
 
       // Combine header and payload vectors by interleaving data nybbles
       header_bytes.insert(header_bytes.end(), payload_bytes.begin(), payload_bytes.end());
+
+      // With an explicit header, or a configured implicit payload length, keep only the payload (and CRC) nybbles
+      if (d_header)
+      {
+        header_bytes.erase(header_bytes.begin(), header_bytes.begin() + PHY_HEADER_NYBBLES);
+        header_bytes.resize(std::min(header_bytes.size(), (size_t)(2*(payload_len + (crc ? CRC16_BYTES : 0)))));
+      }
+      else if (d_payload_length)
+      {
+        header_bytes.resize(std::min(header_bytes.size(), (size_t)(2*(d_payload_length + (d_crc ? CRC16_BYTES : 0)))));
+      }
+
       unsigned int i = 0;
       for (i = 0; i < header_bytes.size(); i++)
       {
@@ -493,10 +553,31 @@ namespace gr {
         }
       }
 
+      // Drop frames that fail the payload CRC-16, which follows the payload at the header's or the configured length
+      if (d_header ? crc : (d_crc && d_payload_length))
+      {
+        size_t frame_len = d_header ? payload_len : d_payload_length;
+        if (!check_crc(combined_bytes, frame_len))
+        {
+          d_crc_fail++;
+          #if DEBUG_OUTPUT
+            std::cout << "payload CRC failed, dropping packet" << std::endl;
+          #endif
+          return;
+        }
+
+        d_crc_pass++;
+        combined_bytes.resize(frame_len);
+        out_meta = pmt::dict_add(out_meta, PDU_KEY_CRC_VALID, pmt::PMT_T);
+      }
+
       pmt::pmt_t output = pmt::init_u8vector(combined_bytes.size(), combined_bytes);
 
 #else // Whitening sequence derivation
 
+      std::vector<unsigned short> &symbols_in = payload_symbols_in;
+      gray_whiten(symbols_v, pkt_len, 0, false, symbols_in);
+
       for (int i = 0; i < symbols_in.size(); i++)
       {
         std::cout << ", " << std::bitset<16>(symbols_in[i]);
@@ -508,10 +589,177 @@ namespace gr {
 
 #endif
 
-      pmt::pmt_t msg_pair = pmt::cons(pmt::make_dict(), output);
+      pmt::pmt_t msg_pair = pmt::cons(out_meta, output);
       message_port_pub(d_out_port, msg_pair);
     }
 
+    void
+    decode_impl::reset_stream()
+    {
+      d_symbols.clear();
+      d_codewords.clear();
+      d_bytes.clear();
+      d_stream_decoded = 0;
+      d_stream_emitted = 0;
+      d_stream_length  = d_header ? 0 : (d_payload_length ? d_payload_length : std::numeric_limits<size_t>::max());
+      d_stream_cr      = d_cr;
+      d_stream_crc     = d_header ? false : (d_crc && d_payload_length);
+      d_stream_valid   = true;
+      d_stream_packet  = pmt::PMT_NIL;
+    }
+
+    unsigned long
+    decode_impl::crc_pass_count() const
+    {
+      return d_crc_pass;
+    }
+
+    unsigned long
+    decode_impl::crc_fail_count() const
+    {
+      return d_crc_fail;
+    }
+
+    // Checks the CRC-16 that follows the first payload_len bytes
+    bool
+    decode_impl::check_crc(const std::vector<unsigned char> &bytes,
+                           size_t payload_len)
+    {
+      unsigned short crc = CRC16_INITIAL;
+
+      if (bytes.size() < payload_len + CRC16_BYTES) return false;
+
+      for (size_t i = 0; i < payload_len; i++)
+      {
+        crc = crc16_update(d_crc_table, crc, bytes[i]);
+      }
+
+      return (((bytes[payload_len] << 8) | bytes[payload_len + 1]) == crc);
+    }
+
+    void
+    decode_impl::decode_stream(pmt::pmt_t msg)
+    {
+      pmt::pmt_t meta(pmt::car(msg));
+      pmt::pmt_t symbols(pmt::cdr(msg));
+
+      if (!pmt::is_dict(meta) || (pmt::to_long(pmt::dict_ref(meta, PDU_KEY_SF, pmt::from_long(d_sf))) != d_sf))
+      {
+        return;
+      }
+
+      // End of packet: flush whatever is left, including a trailing half byte
+      if (pmt::dict_has_key(meta, PDU_KEY_END))
+      {
+        publish_partial(true);
+        reset_stream();
+        return;
+      }
+
+      // A new packet starts at index 0; anything out of sequence belongs to a packet we lost track of
+      size_t index = pmt::to_long(pmt::dict_ref(meta, PDU_KEY_INDEX, pmt::from_long(d_symbols.size())));
+      if (index == 0)
+      {
+        reset_stream();
+        d_stream_packet = pmt::dict_ref(meta, PDU_KEY_PACKET, pmt::PMT_NIL);
+      }
+      else if (index != d_symbols.size())
+      {
+        return;
+      }
+
+      size_t num_symbols(0);
+      const uint16_t* symbols_v = pmt::u16vector_elements(symbols, num_symbols);
+      d_symbols.insert(d_symbols.end(), symbols_v, symbols_v + num_symbols);
+
+      // Decode every complete interleaver block: 8 header symbols at ppm=d_sf-2, rdd=4, then 4+cr payload symbols at a time
+      while (true)
+      {
+        bool          header    = (d_stream_decoded < PHY_HEADER_SYMBOLS);
+        unsigned char rdd       = header ? 4 : d_stream_cr;
+        unsigned char ppm       = (header || d_ldr) ? (d_sf-2) : d_sf;
+        size_t        block_len = header ? PHY_HEADER_SYMBOLS : (4+d_stream_cr);
+
+        if (d_symbols.size() - d_stream_decoded < block_len) break;
+
+        // Nothing left to decode once an explicit header has been rejected
+        if (!d_stream_valid) break;
+
+        // An explicit header is sent without whitening
+        gray_whiten(&d_symbols[d_stream_decoded], block_len, d_stream_decoded, !(header && d_header), d_block);
+
+        d_codewords.clear();
+        deinterleave(d_block, d_codewords, ppm, rdd);
+        hamming_decode(d_codewords, d_bytes, rdd);
+
+        d_stream_decoded += block_len;
+
+        // The explicit header gives the payload length, code rate and CRC flag for the rest of the packet
+        if (header && d_header)
+        {
+          unsigned char payload_len = 0, cr = d_cr;
+          bool          crc = false;
+          bool          valid = (d_bytes.size() >= PHY_HEADER_NYBBLES) &&
+                                  phy_header_parse(&d_bytes[0], d_bytes.size(), payload_len, cr, crc);
+
+          d_stream_valid = valid;
+          if (valid)
+          {
+            d_stream_length = payload_len;
+            d_stream_cr     = cr;
+            d_stream_crc    = crc;
+          }
+        }
+      }
+
+      publish_partial(false);
+    }
+
+    // Publishes the bytes decoded since the last call, in the same nybble order as decode()
+    // With an explicit header, only payload bytes are published, up to the length it gives
+    void
+    decode_impl::publish_partial(bool end)
+    {
+      size_t first_nybble = d_header ? PHY_HEADER_NYBBLES : 0;
+      size_t num_nybbles  = (d_bytes.size() > first_nybble) ? d_bytes.size() - first_nybble : 0;
+      size_t num_bytes    = std::min(end ? (num_nybbles + 1)/2 : num_nybbles/2, d_stream_length);
+
+      if (num_bytes <= d_stream_emitted && !end) return;
+
+      std::vector<unsigned char> &partial_bytes = d_partial_bytes;
+      partial_bytes.clear();
+      for (size_t i = d_stream_emitted; i < num_bytes; i++)
+      {
+        unsigned char byte = (d_bytes[first_nybble + 2*i] << 4) & 0xF0;
+        if (2*i + 1 < num_nybbles) byte |= d_bytes[first_nybble + 2*i + 1] & 0x0F;
+        partial_bytes.push_back(byte);
+      }
+
+      pmt::pmt_t meta = pmt::dict_add(pmt::make_dict(), PDU_KEY_OFFSET, pmt::from_long(d_stream_emitted));
+      if (end) meta = pmt::dict_add(meta, PDU_KEY_END, pmt::PMT_T);
+
+      // Bytes have already gone out by the time the CRC arrives, so the end marker carries the verdict
+      if (end && d_stream_crc)
+      {
+        std::vector<unsigned char> &frame = d_frame;
+        frame.clear();
+        for (size_t i = 0; 2*i + 1 < num_nybbles && i < d_stream_length + CRC16_BYTES; i++)
+        {
+          frame.push_back(((d_bytes[first_nybble + 2*i] << 4) & 0xF0) | (d_bytes[first_nybble + 2*i + 1] & 0x0F));
+        }
+
+        // Not counted here: the same packet is counted when it reaches decode() whole
+        bool valid = check_crc(frame, d_stream_length);
+
+        meta = pmt::dict_add(meta, PDU_KEY_CRC_VALID, pmt::from_bool(valid));
+        if (valid) meta = pmt::dict_add(meta, PDU_KEY_LENGTH, pmt::from_long(d_stream_length));
+      }
+
+      message_port_pub(d_partial_port, pmt::cons(meta, pmt::init_u8vector(partial_bytes.size(), partial_bytes)));
+
+      d_stream_emitted = num_bytes;
+    }
+
   } /* namespace lora */
 } /* namespace gr */
 
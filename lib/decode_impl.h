@@ -25,6 +25,8 @@
 #include <bitset>
 #include <lora/decode.h>
 
+#define MAXIMUM_RDD 4
+
 namespace gr {
   namespace lora {
 
@@ -33,6 +35,8 @@ namespace gr {
      private:
       pmt::pmt_t d_in_port;
       pmt::pmt_t d_out_port;
+      pmt::pmt_t d_stream_port;
+      pmt::pmt_t d_partial_port;
 
       const unsigned short *d_whitening_sequence;
 
@@ -40,33 +44,78 @@ namespace gr {
       unsigned char d_cr;
       bool          d_ldr;
       bool          d_header;
+      bool          d_crc;          // Payload CRC-16 in implicit header mode; an explicit header carries its own flag
+      unsigned char d_payload_length; // Payload length in bytes in implicit header mode, 0 if unknown
 
       unsigned short d_fft_size;
       unsigned char  d_interleaver_size;
 
+      // Streaming decoder state: raw symbols of the packet in progress, and the data nybbles decoded from them so far
       std::vector<unsigned short> d_symbols;
       std::vector<unsigned char> d_codewords;
       std::vector<unsigned char> d_bytes;
+      size_t d_stream_decoded;      // Symbols already deinterleaved
+      size_t d_stream_emitted;      // Bytes already published on the partial port
+      size_t d_stream_length;       // Payload length in bytes, once known from an explicit header or configured for implicit mode
+      unsigned char d_stream_cr;    // Code rate of the payload blocks
+      bool          d_stream_crc;   // Whether a CRC-16 follows the payload
+      bool          d_stream_valid; // Cleared when an explicit header fails its checksum
+      pmt::pmt_t    d_stream_packet;
+      std::vector<unsigned short> d_block;          // Interleaver block being decoded from d_symbols
+      std::vector<unsigned char>  d_partial_bytes;  // Bytes for the next partial port message
+      std::vector<unsigned char>  d_frame;          // Whole frame, for the CRC check at the end of a streamed packet
+
+      // Batch decoder scratch, cleared per packet but never freed, so steady-state decoding does not allocate
+      std::vector<unsigned short> d_header_symbols;
+      std::vector<unsigned short> d_payload_symbols;
+      std::vector<unsigned char>  d_header_codewords;
+      std::vector<unsigned char>  d_payload_codewords;
+      std::vector<unsigned char>  d_header_nybbles;
+      std::vector<unsigned char>  d_payload_nybbles;
+      std::vector<unsigned char>  d_frame_bytes;
+
+      // Corrected data nybble (plus HAMMING_ERROR_FLAG) for every raw codeword, indexed [rdd-1][codeword]
+      unsigned char d_hamming_table[MAXIMUM_RDD][256];
+
+      // Valid codeword for every data nybble, as laid out by the deinterleaver before Hamming reordering, indexed [rdd-1][nybble]
+      unsigned char d_soft_codewords[MAXIMUM_RDD][16];
+
+      unsigned short d_crc_table[256];
+      unsigned long  d_crc_pass;
+      unsigned long  d_crc_fail;
 
      public:
       decode_impl(  short spreading_factor,
                     short code_rate,
                     bool  low_data_rate,
-                    bool  header);
+                    bool  header,
+                    bool  crc,
+                    short payload_length);
       ~decode_impl();
 
       void to_gray(std::vector<unsigned short> &symbols);
       void from_gray(std::vector<unsigned short> &symbols);
-      void whiten(std::vector<unsigned short> &symbols);
-      void deinterleave(std::vector<unsigned short> &symbols, std::vector<unsigned char> &codewords, unsigned char ppm, unsigned char rdd);
+      void whiten(std::vector<unsigned short> &symbols, size_t offset = 0);
+      void gray_whiten(const uint16_t *symbols, size_t num_symbols, size_t offset, bool whitened, std::vector<unsigned short> &out);
+      void deinterleave(const std::vector<unsigned short> &symbols, std::vector<unsigned char> &codewords, unsigned char ppm, unsigned char rdd);
       void hamming_decode(std::vector<unsigned char> &codewords, std::vector<unsigned char> &bytes, unsigned char rdd);
+      void soft_decode(const uint16_t *candidates, const float *magnitudes, const float *noise, size_t num_candidates,
+                       size_t first_symbol, size_t num_symbols, unsigned char ppm, unsigned char rdd, bool whitened,
+                       std::vector<unsigned char> &nybbles);
       unsigned char parity(unsigned char c, unsigned char bitmask);
       void print_payload(std::vector<unsigned char> &payload);
 
       void print_bitwise_u8 (std::vector<unsigned char>  &buffer);
       void print_bitwise_u16(std::vector<unsigned short> &buffer);
 
+      unsigned long crc_pass_count() const;
+      unsigned long crc_fail_count() const;
+
       void decode(pmt::pmt_t msg);
+      void decode_stream(pmt::pmt_t msg);
+      void publish_partial(bool end);
+      void reset_stream();
+      bool check_crc(const std::vector<unsigned char> &bytes, size_t payload_len);
 
     };
 
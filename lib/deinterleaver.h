@@ -0,0 +1,135 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_DEINTERLEAVER_H
+#define INCLUDED_LORA_DEINTERLEAVER_H
+
+#include <stddef.h>
+#include "bit_transpose.h"
+
+namespace gr {
+  namespace lora {
+
+    // Reverse interleaver (de-interleaver) dimensions:
+    //  PPM   == number of bits per symbol IN to deinterleaver       AND number of codewords OUT of deinterleaver
+    //  RDD+4 == number of bits per codeword OUT of deinterleaver    AND number of interleaved codewords IN to deinterleaver
+    //
+    // bit width in:  ppm       block length: (4+rdd)
+    // bit width out: (4+rdd)   block length: ppm
+
+    // De-interleaves one block of 4+rdd symbols into ppm codewords, codeword cw in block[cw]
+    //
+    // Bit s of codeword cw is bit (ppm-1-(s+cw)%ppm) of symbol s.  Rotating symbol s
+    // left by s lines that bit up at column ppm-1-cw for every symbol, so the whole
+    // block becomes a plain bit-matrix transpose of the rotated symbols.
+    inline void
+    deinterleave_block(const unsigned short *symbols,
+                       unsigned char ppm,
+                       unsigned char rdd,
+                       unsigned char *block)
+    {
+      uint64_t lo_rows = 0;
+      uint64_t hi_rows = 0;
+
+      for (int s = 0; s < (4+rdd); s++)
+      {
+        unsigned short row = rotate_left(symbols[s], s, ppm);
+        lo_rows |= (uint64_t)(row & 0xFF) << (8*s);
+        hi_rows |= (uint64_t)(row >> 8)   << (8*s);
+      }
+
+      lo_rows = transpose_8x8(lo_rows);
+      hi_rows = transpose_8x8(hi_rows);
+
+      for (int cw_idx = 0; cw_idx < ppm; cw_idx++)
+      {
+        int column = ppm-1-cw_idx;
+        block[cw_idx] = (column < 8) ? (lo_rows >> (8*column)) & 0xFF : (hi_rows >> (8*(column-8))) & 0xFF;
+      }
+    }
+
+    // De-interleaves every complete block of num_symbols raw symbols into codewords, in traditional Hamming
+    // bit order and packet order, ready for the Hamming decoder.  Returns the number of codewords written.
+    inline size_t
+    deinterleave_codewords(const unsigned short *symbols,
+                           size_t num_symbols,
+                           unsigned char ppm,
+                           unsigned char rdd,
+                           unsigned char *codewords)
+    {
+      unsigned short swapped[8];
+      unsigned char  block[INTERLEAVER_BLOCK_SIZE];
+      size_t         num_codewords = 0;
+
+      for (size_t block_start = 0; block_start + (4+rdd) <= num_symbols; block_start += (4+rdd))
+      {
+        // Swap MSBs of each symbol (one of LoRa's quirks)
+        for (int s = 0; s < (4+rdd); s++)
+        {
+          unsigned short symbol = symbols[block_start + s];
+          swapped[s] = ( (symbol &  (0x1 << (ppm-1))) >> 1 |
+                         (symbol &  (0x1 << (ppm-2))) << 1 |
+                         (symbol & ((0x1 << (ppm-2)) - 1)) );
+        }
+
+        deinterleave_block(swapped, ppm, rdd, block);
+
+        // Post-process de-interleaved codewords
+        for (int cw_idx = 0; cw_idx < ppm; cw_idx++)
+        {
+          // Put bits into traditional Hamming order
+          switch (rdd)
+          {
+            case 4:
+              block[cw_idx] = (block[cw_idx] & 128) | (block[cw_idx] & 64) | (block[cw_idx] & 32) >> 5 | (block[cw_idx] & 16) | (block[cw_idx] & 8) << 2 | (block[cw_idx] & 4) << 1 | (block[cw_idx] & 2) << 1 | (block[cw_idx] & 1) << 1;
+              break;
+
+            case 3:
+              block[cw_idx] = (block[cw_idx] & 64) | (block[cw_idx] & 32) | (block[cw_idx] & 16) >> 1 | (block[cw_idx] & 8) << 1 | (block[cw_idx] & 4) | (block[cw_idx] & 2) | (block[cw_idx] & 1);
+              break;
+
+            default:
+              break;
+          }
+
+          // Mask
+          block[cw_idx] = block[cw_idx] & ((1 << (4+rdd)) - 1);
+        }
+
+        // Append deinterleaved codewords, rearranging into proper order:
+        // pairs from the top down (..., 4, 5, 2, 3, 0, 1), led by the top codeword alone if ppm is odd
+        if (ppm % 2)
+        {
+          codewords[num_codewords++] = block[ppm-1];
+        }
+        for (int cw_idx = (ppm & ~0x1) - 2; cw_idx >= 0; cw_idx -= 2)
+        {
+          codewords[num_codewords++] = block[cw_idx];
+          codewords[num_codewords++] = block[cw_idx+1];
+        }
+      }
+
+      return num_codewords;
+    }
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_DEINTERLEAVER_H */
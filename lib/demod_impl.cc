@@ -23,7 +23,14 @@
 #endif
 
 #include <gnuradio/io_signature.h>
+#include <algorithm>
 #include "demod_impl.h"
+#include "dechirp.h"
+#include "fft_peak.h"
+#include "hamming.h"
+#include "pdu_keys.h"
+#include "phy_header.h"
+#include "sync_offset.h"
 
 #define DEBUG_OFF     0
 #define DEBUG_INFO    1
@@ -35,6 +42,11 @@
 #define OVERLAP_DEFAULT 1
 #define OVERLAP_FACTOR  16
 
+#define SOFT_CANDIDATES   4       // Strongest symbol values reported per symbol in soft decoding mode
+
+#define DECIM_CUTOFF      0.5     // Half the chip rate, in units of the chip rate
+#define DECIM_TRANSITION  0.25    // MAGIC
+
 namespace gr {
   namespace lora {
 
@@ -42,10 +54,15 @@ namespace gr {
     demod::make(  unsigned short spreading_factor,
                   bool  low_data_rate,
                   float beta,
-                  unsigned short fft_factor)
+                  unsigned short fft_factor,
+                  bool  batch_sync,
+                  unsigned short oversampling,
+                  bool  soft_decoding,
+                  bool  header,
+                  bool  stream)
     {
       return gnuradio::get_initial_sptr
-        (new demod_impl(spreading_factor, low_data_rate, beta, fft_factor));
+        (new demod_impl(spreading_factor, low_data_rate, beta, fft_factor, batch_sync, oversampling, soft_decoding, header, stream));
     }
 
     /*
@@ -54,26 +71,63 @@ namespace gr {
     demod_impl::demod_impl( unsigned short spreading_factor,
                             bool  low_data_rate,
                             float beta,
-                            unsigned short fft_factor)
+                            unsigned short fft_factor,
+                            bool  batch_sync,
+                            unsigned short oversampling,
+                            bool  soft_decoding,
+                            bool  header,
+                            bool  stream)
       : gr::block("demod",
               gr::io_signature::make(1, 1, sizeof(gr_complex)),
               gr::io_signature::make(0, 0, 0)),
-        f_raw("raw.out", std::ios::out),
-        f_up_windowless("up_windowless.out", std::ios::out),
-        f_up("up.out", std::ios::out),
-        f_down("down.out", std::ios::out),
         d_sf(spreading_factor),
         d_ldr(low_data_rate),
         d_beta(beta),
-        d_fft_size_factor(fft_factor)
+        d_fft_size_factor(fft_factor),
+        d_batch_sync(batch_sync),
+        d_oversampling(oversampling),
+        d_soft_decoding(soft_decoding),
+        d_header(header),
+        d_stream(stream),
+        d_argmax_history(REQUIRED_PREAMBLE_CHIRPS),
+        d_sfd_history(REQUIRED_SFD_CHIRPS*OVERLAP_FACTOR)
     {
       assert((d_sf > 5) && (d_sf < 13));
       if (d_sf == 6) assert(!header);
       assert(d_fft_size_factor > 0);
+      assert(d_oversampling > 0);
 
       d_out_port = pmt::mp("out");
       message_port_register_out(d_out_port);
 
+      // Registered either way so flowgraphs connect, but only published to when stream is set
+      d_stream_port = pmt::mp("stream");
+      message_port_register_out(d_stream_port);
+      d_stream_meta = pmt::PMT_NIL;
+      d_stream_end  = pmt::make_u16vector(0, 0);
+
+      // The explicit header is decoded here as soon as its block is in, so the packet can end on its last symbol
+      hamming_build_table(d_header_hamming, 4);
+
+      d_packet_id      = 0;
+      d_packet_symbols = 0;
+
+      d_preamble_frac  = 0;
+      d_cfo            = 0;
+      d_sto            = 0;
+      d_track_offset   = 0;
+      d_applied_offset = 0;
+
+      // Symbol buffers are cleared per packet but keep their capacity; size them for the longest explicit header packet
+      size_t max_symbols = phy_packet_symbols(d_sf, 255, 4, true, d_ldr);
+      d_symbols.reserve(max_symbols);
+      if (d_soft_decoding)
+      {
+        d_soft_symbols.reserve(max_symbols*SOFT_CANDIDATES);
+        d_soft_magnitudes.reserve(max_symbols*SOFT_CANDIDATES);
+        d_soft_noise.reserve(max_symbols);
+      }
+
       d_state = S_RESET;
 
       d_num_symbols = (1 << d_sf);
@@ -85,22 +139,85 @@ namespace gr {
       d_window = fft::window::build(fft::window::WIN_KAISER, d_num_symbols, d_beta);
 
       d_power     = .000000001;     // MAGIC
+      d_noise_floor = 0;
       d_threshold = 0.005;          // MAGIC
       // d_threshold = 0.003;          // MAGIC
       // d_threshold = 0.12;           // MAGIC
 
-      float phase = -M_PI;
-      double accumulator = 0;
-
       // Create local chirp tables.  Each table is 2 chirps long to allow memcpying from arbitrary offsets.
-      for (int i = 0; i < 2*d_num_symbols; i++) {
-        accumulator += phase;
-        d_downchirp.push_back(gr_complex(std::conj(std::polar(1.0, accumulator))));
-        d_upchirp.push_back(gr_complex(std::polar(1.0, accumulator)));
-        phase += (2*M_PI)/d_num_symbols;
+      build_chirps(d_num_symbols, d_upchirp, d_downchirp);
+
+      d_fft_mag    = (float      *)alloc_scratch(d_fft_size*sizeof(float));
+
+      // Unwindowed dechirp buffers, only needed to write IQ to disk for debugging
+      // Nomenclature:
+      //  up_block   == de-chirping buffer to contain upchirp features: the preamble, sync word, and data chirps
+      //  down_block == de-chirping buffer to contain downchirp features: the SFD
+      #if DUMP_IQ
+        d_up_block   = (gr_complex *)alloc_scratch(d_num_symbols*sizeof(gr_complex));
+        d_down_block = (gr_complex *)alloc_scratch(d_num_symbols*sizeof(gr_complex));
+
+        f_raw.open("raw.out", std::ios::out);
+        f_up_windowless.open("up_windowless.out", std::ios::out);
+        f_up.open("up.out", std::ios::out);
+        f_down.open("down.out", std::ios::out);
+      #else
+        d_up_block   = NULL;
+        d_down_block = NULL;
+      #endif
+
+      // Downchirps with the window folded in, one table per offset the state machine can sync to
+      // SFD sync lands on a multiple of d_num_symbols/OVERLAP_FACTOR, so there are OVERLAP_FACTOR distinct offsets
+      d_windowed_downchirp = (gr_complex *)alloc_scratch(OVERLAP_FACTOR*d_num_symbols*sizeof(gr_complex));
+      d_compensated_downchirp = (gr_complex *)alloc_scratch(d_num_symbols*sizeof(gr_complex));
+      d_soft_energy        = d_soft_decoding ? (float *)alloc_scratch(d_num_symbols*sizeof(float)) : NULL;
+      build_windowed_downchirps(&d_downchirp[0], &d_window[0], d_num_symbols, OVERLAP_FACTOR, d_windowed_downchirp);
+
+      // Only the first d_num_symbols samples of the FFT input are ever written; the zero padding is permanent
+      memset(d_fft->get_inbuf(), 0, d_fft_size*sizeof(gr_complex));
+
+      // Optionally compute all OVERLAP_FACTOR overlapped SFD FFTs with one batched FFTW plan
+      d_sync_in   = NULL;
+      d_sync_out  = NULL;
+      d_sync_plan = NULL;
+      if (d_batch_sync)
+      {
+        int n = d_fft_size;
+
+        d_sync_in  = (gr_complex *)fftwf_malloc(OVERLAP_FACTOR*d_fft_size*sizeof(gr_complex));
+        d_sync_out = (gr_complex *)fftwf_malloc(OVERLAP_FACTOR*d_fft_size*sizeof(gr_complex));
+        if (d_sync_in == NULL || d_sync_out == NULL)
+        {
+          throw std::bad_alloc();
+        }
+
+        {
+          // The FFTW planner is not thread safe; share GNU Radio's planner lock
+          fft::planner::scoped_lock lock(fft::planner::mutex());
+          d_sync_plan = fftwf_plan_many_dft(1, &n, OVERLAP_FACTOR,
+                                            reinterpret_cast<fftwf_complex *>(d_sync_in),  NULL, 1, d_fft_size,
+                                            reinterpret_cast<fftwf_complex *>(d_sync_out), NULL, 1, d_fft_size,
+                                            FFTW_FORWARD, FFTW_MEASURE);
+        }
+
+        // Planning with FFTW_MEASURE clobbers the input, so zero the padding afterwards
+        memset(d_sync_in, 0, OVERLAP_FACTOR*d_fft_size*sizeof(gr_complex));
       }
 
-      set_history(DEMOD_HISTORY_DEPTH*d_num_symbols);  // Sync is 2.25 chirp periods long
+      // Oversampled input is decimated to one sample per chip inside the block
+      // Only the chip-rate outputs a symbol step reads are computed, and only on demand
+      d_decimator = NULL;
+      d_decim     = NULL;
+      if (d_oversampling > 1)
+      {
+        std::vector<float> taps = filter::firdes::low_pass(1.0, d_oversampling, DECIM_CUTOFF, DECIM_TRANSITION);
+
+        d_decimator = new filter::kernel::fir_filter_ccf(d_oversampling, taps);
+        d_decim     = (gr_complex *)alloc_scratch(2*d_num_symbols*sizeof(gr_complex));
+      }
+
+      // Sync is 2.25 chirp periods long; the decimation filter reads its length past the last chip
+      set_history(DEMOD_HISTORY_DEPTH*d_num_symbols*d_oversampling + (d_decimator ? d_decimator->ntaps() : 0));
     }
 
     /*
@@ -108,114 +225,275 @@ namespace gr {
      */
     demod_impl::~demod_impl()
     {
+      if (d_batch_sync)
+      {
+        fft::planner::scoped_lock lock(fft::planner::mutex());
+        fftwf_destroy_plan(d_sync_plan);
+        fftwf_free(d_sync_out);
+        fftwf_free(d_sync_in);
+      }
+
+      if (d_oversampling > 1)
+      {
+        volk_free(d_decim);
+        delete d_decimator;
+      }
+
+      if (d_soft_decoding)
+      {
+        volk_free(d_soft_energy);
+      }
+
+      volk_free(d_compensated_downchirp);
+      volk_free(d_windowed_downchirp);
+      volk_free(d_fft_mag);
+
+      #if DUMP_IQ
+        volk_free(d_down_block);
+        volk_free(d_up_block);
+      #endif
+
       delete d_fft;
     }
 
+    void *
+    demod_impl::alloc_scratch(size_t num_bytes)
+    {
+      void *scratch = volk_malloc(num_bytes, volk_get_alignment());
+
+      if (scratch == NULL)
+      {
+        throw std::bad_alloc();
+      }
+
+      return scratch;
+    }
+
+    const gr_complex *
+    demod_impl::windowed_downchirp(unsigned short offset)
+    {
+      assert(offset % (d_num_symbols/OVERLAP_FACTOR) == 0);
+
+      return &d_windowed_downchirp[(offset/(d_num_symbols/OVERLAP_FACTOR))*d_num_symbols];
+    }
+
     unsigned short
     demod_impl::argmax(gr_complex *fft_result, 
                        bool update_squelch)
     {
-      float magsq   = pow(real(fft_result[0]), 2) + pow(imag(fft_result[0]), 2);
-      float max_val = magsq;
-      unsigned short   max_idx = 0;
+      float    sum     = 0;
 
-
-      for (unsigned short i = 0; i < d_fft_size; i++)
-      {
-        magsq = pow(real(fft_result[i]), 2) + pow(imag(fft_result[i]), 2);
-        if (magsq > max_val)
-        {
-          max_idx = i;
-          max_val = magsq;
-        }
-      }
+      // Power of every bin, index of the peak bin and total power, in a single pass over the FFT output
+      uint16_t max_idx = fft_peak(fft_result, d_fft_mag, d_fft_size, sum);
 
       if (update_squelch)
       {
-        d_power = max_val;
-        d_squelched = (d_power > d_threshold) ? false : true;
+        // Noise floor is the mean power of every bin other than the peak
+        d_power       = d_fft_mag[max_idx];
+        d_noise_floor = (sum - d_power) / (d_fft_size - 1);
+        d_squelched   = (d_power > d_threshold) ? false : true;
       }
 
       return max_idx;
     }
 
+    // Symbol value [0:(2**sf)-1] of an FFT bin, relative to the preamble, rounded to the nearest symbol bin
+    unsigned short
+    demod_impl::normalize(unsigned short bin)
+    {
+      return ((d_fft_size + bin - d_preamble_idx + d_fft_size_factor/2) / d_fft_size_factor) % d_num_symbols;
+    }
+
+    // Rebuilds d_compensated_downchirp from the windowed downchirp at d_offset, shifted to cancel a
+    // frequency offset given in symbol bins, so data symbols land on whole bins even at d_fft_size_factor 1
+    void
+    demod_impl::compensate_downchirp(float offset)
+    {
+      gr_complex phase     = gr_complex(1.0f, 0.0f);
+      gr_complex phase_inc = std::polar(1.0f, (float)(-2*M_PI*offset/d_num_symbols));
+
+      volk_32fc_s32fc_x2_rotator_32fc(d_compensated_downchirp, windowed_downchirp(d_offset), phase_inc, &phase, d_num_symbols);
+      d_applied_offset = offset;
+    }
+
+    // First-order loop on the residual sub-bin offset of each data symbol, following carrier drift over long packets
+    void
+    demod_impl::track_offset(unsigned short max_idx)
+    {
+      float residual = symbol_residual(d_fft_mag, d_fft_size, d_fft_size_factor, max_idx, d_preamble_idx);
+
+      d_track_offset = track_offset_update(d_track_offset, d_applied_offset, residual/d_fft_size_factor);
+
+      if (fabsf(d_track_offset - d_applied_offset) > CFO_REBUILD_THRESHOLD)
+      {
+        compensate_downchirp(d_track_offset);
+      }
+    }
+
     void
     demod_impl::forecast (int noutput_items,
                           gr_vector_int &ninput_items_required)
     {
-      ninput_items_required[0] = noutput_items * (1 << d_sf);
+      ninput_items_required[0] = noutput_items * (1 << d_sf) * d_oversampling;
     }
 
-    int
-    demod_impl::general_work (int noutput_items,
-                       gr_vector_int &ninput_items,
-                       gr_vector_const_void_star &input_items,
-                       gr_vector_void_star &output_items)
+    void
+    demod_impl::soft_candidates(bool reduced_rate)
     {
-      const gr_complex *in = (const gr_complex *)  input_items[0];
-      unsigned short  *out = (unsigned short   *) output_items[0];
-      unsigned short num_consumed = d_num_symbols;
-      unsigned short max_index = 0;
-      bool preamble_found = false;
-      bool sfd_found      = false;
+      unsigned short num_values = reduced_rate ? d_num_symbols/4 : d_num_symbols;
+      uint16_t       max_idx    = 0;
 
-      // Nomenclature:
-      //  up_block   == de-chirping buffer to contain upchirp features: the preamble, sync word, and data chirps
-      //  down_block == de-chirping buffer to contain downchirp features: the SFD
-      gr_complex *buffer     = (gr_complex *)volk_malloc(d_fft_size*sizeof(gr_complex), volk_get_alignment());
-      gr_complex *up_block   = (gr_complex *)volk_malloc(d_fft_size*sizeof(gr_complex), volk_get_alignment());
-      gr_complex *down_block = (gr_complex *)volk_malloc(d_fft_size*sizeof(gr_complex), volk_get_alignment());
+      // Fold the FFT bins onto symbol values with the same normalization as the hard decision, keeping each value's strongest bin
+      std::fill(d_soft_energy, d_soft_energy + num_values, 0.0f);
+      for (unsigned int bin = 0; bin < d_fft_size; bin++)
+      {
+        unsigned short value = normalize(bin);
+        if (reduced_rate) value /= 4;
 
-      if (buffer == NULL || up_block == NULL || down_block == NULL)
+        d_soft_energy[value] = std::max(d_soft_energy[value], d_fft_mag[bin]);
+      }
+
+      for (int k = 0; k < SOFT_CANDIDATES; k++)
       {
-        std::cerr << "Unable to allocate processing buffer!" << std::endl;
+        volk_32f_index_max_16u(&max_idx, d_soft_energy, num_values);
+
+        d_soft_symbols.push_back(max_idx);
+        d_soft_magnitudes.push_back(d_soft_energy[max_idx]);
+        d_soft_energy[max_idx] = -1.0f;
       }
 
-      // Dechirp the incoming signal
-      volk_32fc_x2_multiply_32fc(down_block, in, &d_upchirp[0], d_num_symbols);
+      d_soft_noise.push_back(d_noise_floor);
+    }
 
-      if (d_state == S_READ_HEADER || d_state == S_READ_PAYLOAD)
+    void
+    demod_impl::stream_symbol()
+    {
+      // The newest symbol goes out on its own, so a decoder can start on each interleaver block before the packet ends
+      pmt::pmt_t meta = pmt::dict_add(d_stream_meta, PDU_KEY_INDEX, pmt::from_long(d_symbols.size() - 1));
+
+      message_port_pub(d_stream_port, pmt::cons(meta, pmt::init_u16vector(1, &d_symbols.back())));
+    }
+
+    void
+    demod_impl::publish_packet()
+    {
+      // Drop any symbols demodulated past the end given by an explicit header
+      if (d_packet_symbols && d_symbols.size() > d_packet_symbols)
       {
-        volk_32fc_x2_multiply_32fc(up_block, in, &d_downchirp[d_offset], d_num_symbols);
+        d_symbols.resize(d_packet_symbols);
+        if (d_soft_decoding)
+        {
+          d_soft_symbols.resize(d_packet_symbols*SOFT_CANDIDATES);
+          d_soft_magnitudes.resize(d_packet_symbols*SOFT_CANDIDATES);
+          d_soft_noise.resize(d_packet_symbols);
+        }
+      }
+
+      pmt::pmt_t meta = pmt::make_dict();
+      meta = pmt::dict_add(meta, PDU_KEY_SF,        pmt::from_long(d_sf));
+      meta = pmt::dict_add(meta, PDU_KEY_PACKET,    pmt::from_uint64(d_packet_id));
+
+      // Synchronization estimates: CFO in symbol bins (BW/2**sf Hz each), its drift over the packet, and STO in chips
+      meta = pmt::dict_add(meta, PDU_KEY_CFO,       pmt::from_double(d_cfo));
+      meta = pmt::dict_add(meta, PDU_KEY_CFO_DRIFT, pmt::from_double(d_track_offset - d_preamble_frac));
+      meta = pmt::dict_add(meta, PDU_KEY_STO,       pmt::from_double(d_sto));
+
+      // Soft decisions: the SOFT_CANDIDATES strongest values of every symbol with their bin powers, and each symbol's noise floor
+      if (d_soft_decoding)
+      {
+        size_t num_symbols = d_symbols.size();
+        meta = pmt::dict_add(meta, PDU_KEY_SOFT_CANDIDATES, pmt::from_long(SOFT_CANDIDATES));
+        meta = pmt::dict_add(meta, PDU_KEY_SOFT_SYMBOLS,    pmt::init_u16vector(num_symbols*SOFT_CANDIDATES, d_soft_symbols));
+        meta = pmt::dict_add(meta, PDU_KEY_SOFT_MAGNITUDES, pmt::init_f32vector(num_symbols*SOFT_CANDIDATES, d_soft_magnitudes));
+        meta = pmt::dict_add(meta, PDU_KEY_SOFT_NOISE,      pmt::init_f32vector(num_symbols, d_soft_noise));
+      }
+
+      pmt::pmt_t output = pmt::init_u16vector(d_symbols.size(), d_symbols);
+      pmt::pmt_t msg_pair = pmt::cons(meta, output);
+      message_port_pub(d_out_port, msg_pair);
+
+      // Mark the end of the packet on the symbol stream
+      if (d_stream)
+      {
+        message_port_pub(d_stream_port, pmt::cons(pmt::dict_add(d_stream_meta, PDU_KEY_END, pmt::PMT_T), d_stream_end));
+      }
+    }
+
+    // Decodes the explicit header from the first PHY_HEADER_SYMBOLS symbols, setting the packet's symbol count
+    // A header that fails its checksum ends the packet at the header block; the decoder drops it
+    void
+    demod_impl::read_header()
+    {
+      unsigned char payload_len, cr;
+      bool          crc;
+
+      if (phy_header_decode(&d_symbols[0], d_sf, d_header_hamming, payload_len, cr, crc))
+      {
+        d_packet_symbols = phy_packet_symbols(d_sf, payload_len, cr, crc, d_ldr);
       }
       else
       {
-        volk_32fc_x2_multiply_32fc(up_block, in, &d_downchirp[0], d_num_symbols);
+        d_packet_symbols = PHY_HEADER_SYMBOLS;
       }
 
-      // Enable to write IQ to disk for debugging
-      #if DUMP_IQ
-        f_up_windowless.write((const char*)&up_block[0], d_num_symbols*sizeof(gr_complex));
+      #if DEBUG >= DEBUG_INFO
+        std::cout << "Explicit header: " << d_packet_symbols << " symbols" << std::endl;
       #endif
+    }
 
-      // Windowing
-      volk_32fc_32f_multiply_32fc(up_block, up_block, &d_window[0], d_num_symbols);
+    unsigned int
+    demod_impl::demod_symbol(const gr_complex *in)
+    {
+      unsigned int   num_consumed = d_num_symbols;
+      unsigned short max_index = 0;
+      bool preamble_found = false;
+      bool sfd_found      = false;
+      bool sfd_window_full = false;
+
+      gr_complex *fft_in  = d_fft->get_inbuf();
+      gr_complex *fft_out = d_fft->get_outbuf();
 
+      // Dechirp and window the incoming signal in a single pass, straight into the FFT input buffer
+      // If d_fft_size_factor is greater than 1, the rest of the FFT input stays zeroed from construction and blends into the window
+      if (d_state == S_READ_HEADER || d_state == S_READ_PAYLOAD)
+      {
+        volk_32fc_x2_multiply_32fc(fft_in, in, d_compensated_downchirp, d_num_symbols);
+      }
+      else
+      {
+        volk_32fc_x2_multiply_32fc(fft_in, in, windowed_downchirp(0), d_num_symbols);
+      }
+
+      // Enable to write IQ to disk for debugging
       #if DUMP_IQ
-        if (d_state != S_SFD_SYNC) f_down.write((const char*)&down_block[0], d_num_symbols*sizeof(gr_complex));
-        f_up.write((const char*)&up_block[0], d_num_symbols*sizeof(gr_complex));
+        volk_32fc_x2_multiply_32fc(d_up_block,   in, &d_downchirp[(d_state == S_READ_HEADER || d_state == S_READ_PAYLOAD) ? d_offset : 0], d_num_symbols);
+        volk_32fc_x2_multiply_32fc(d_down_block, in, &d_upchirp[0], d_num_symbols);
+        f_up_windowless.write((const char*)&d_up_block[0], d_num_symbols*sizeof(gr_complex));
+        if (d_state != S_SFD_SYNC) f_down.write((const char*)&d_down_block[0], d_num_symbols*sizeof(gr_complex));
+        f_up.write((const char*)&fft_in[0], d_num_symbols*sizeof(gr_complex));
       #endif
 
       // Preamble and Data FFT
-      // If d_fft_size_factor is greater than 1, the rest of the sample buffer will be zeroed out and blend into the window
-      memset(d_fft->get_inbuf(),            0, d_fft_size*sizeof(gr_complex));
-      memcpy(d_fft->get_inbuf(), &up_block[0], d_num_symbols*sizeof(gr_complex));
       d_fft->execute();
 
       // Take argmax of returned FFT (similar to MFSK demod)
-      max_index = argmax(d_fft->get_outbuf(), true);
-      d_argmax_history.insert(d_argmax_history.begin(), max_index);
-
-      if (d_argmax_history.size() > REQUIRED_PREAMBLE_CHIRPS)
-      {
-        d_argmax_history.pop_back();
-      }
+      max_index = argmax(fft_out, true);
+      d_argmax_history.push(max_index);
 
       switch (d_state) {
       case S_RESET:
         d_overlaps = OVERLAP_DEFAULT;
         d_offset = 0;
         d_symbols.clear();
+        d_soft_symbols.clear();
+        d_soft_magnitudes.clear();
+        d_soft_noise.clear();
+        d_packet_symbols = 0;
+        d_preamble_frac  = 0;
+        d_cfo            = 0;
+        d_sto            = 0;
+        d_track_offset   = 0;
+        d_applied_offset = 0;
         d_argmax_history.clear();
         d_sfd_history.clear();
         d_sync_recovery_counter = 0;
@@ -252,18 +530,13 @@ namespace gr {
         #endif
 
         // Check for discontinuities that exceed some tolerance
-        preamble_found = true;
-        for (int i = 1; i < REQUIRED_PREAMBLE_CHIRPS; i++)
-        {
-          if (abs(int(d_preamble_idx) - int(d_argmax_history[i])) > LORA_PREAMBLE_TOLERANCE)
-          {
-            preamble_found = false;
-          }
-        }
+        preamble_found = d_argmax_history.within_tolerance(LORA_PREAMBLE_TOLERANCE);
 
         // Advance to SFD/sync discovery if a contiguous preamble is found
         if (preamble_found and !d_squelched)
         {
+          d_preamble_frac = peak_offset(d_fft_mag, d_fft_size, max_index)/d_fft_size_factor;
+
           d_state = S_SFD_SYNC;
 
           #if DEBUG >= DEBUG_INFO
@@ -291,52 +564,64 @@ namespace gr {
           #endif
         }
 
+        // Batched mode: dechirp every overlap up front and run all of the FFTs as a single job
+        if (d_batch_sync && d_overlaps == OVERLAP_FACTOR)
+        {
+          for (int ol = 0; ol < OVERLAP_FACTOR; ol++)
+          {
+            volk_32fc_x2_multiply_32fc(&d_sync_in[ol*d_fft_size],
+                                       &in[(ol*d_num_symbols)/OVERLAP_FACTOR],
+                                       &d_upchirp[(ol*d_num_symbols)/OVERLAP_FACTOR],
+                                       d_num_symbols);
+          }
+
+          fftwf_execute(d_sync_plan);
+        }
+
         // Iterate through sample buffer
         for (int ol = 0; ol < d_overlaps; ol++)
         {
           d_offset = ((ol*d_num_symbols)/d_overlaps) % d_num_symbols;
 
-          // Fill working buffer based on offset
-          for (int j = 0; j < d_num_symbols; j++)
-          {
-            buffer[j] = in[d_offset+j];
-          }
-
           #if DEBUG >= DEBUG_VERBOSE
             std::cout << "ol: " << std::dec << ol << " d_overlaps: " << d_overlaps << std::endl;
           #endif
 
-          // Dechirp
-          volk_32fc_x2_multiply_32fc(down_block, buffer, &d_upchirp[d_offset], d_num_symbols);
+          if (d_batch_sync && d_overlaps == OVERLAP_FACTOR)
+          {
+            #if DUMP_IQ
+              f_down.write((const char*)&d_sync_in[ol*d_fft_size], d_num_symbols*sizeof(gr_complex));
+            #endif
+
+            fft_out = &d_sync_out[ol*d_fft_size];
+          }
+          else
+          {
+            // Dechirp directly from the offset input into the FFT input buffer
+            volk_32fc_x2_multiply_32fc(fft_in, &in[d_offset], &d_upchirp[d_offset], d_num_symbols);
 
-          // Enable to write out overlapped chirps to disk for debugging
-          #if DUMP_IQ
-            f_down.write((const char*)&down_block[0], d_num_symbols*sizeof(gr_complex));
-          #endif
+            // Enable to write out overlapped chirps to disk for debugging
+            #if DUMP_IQ
+              f_down.write((const char*)&fft_in[0], d_num_symbols*sizeof(gr_complex));
+            #endif
 
-          memset(d_fft->get_inbuf(),          0, d_fft_size*sizeof(gr_complex));
-          memcpy(d_fft->get_inbuf(), down_block, d_num_symbols*sizeof(gr_complex));
-          d_fft->execute();
+            d_fft->execute();
+            fft_out = d_fft->get_outbuf();
+          }
 
           // Take argmax of downchirp FFT
-          max_index = argmax(d_fft->get_outbuf(), false); 
-          d_sfd_history.insert(d_sfd_history.begin(), max_index);
+          max_index = argmax(fft_out, false); 
 
-          if (d_sfd_history.size() > REQUIRED_SFD_CHIRPS*OVERLAP_FACTOR)
-          {
-            d_sfd_history.pop_back();
+          // Only test for the SFD once the history window has been completely refilled
+          sfd_window_full = d_sfd_history.full();
+          d_sfd_history.push(max_index);
 
-            sfd_found = true;
+          if (sfd_window_full)
+          {
             d_sfd_idx = d_sfd_history[0];
 
             // Check for discontinuities that exceed some preset tolerance
-            for (int i = 1; i < REQUIRED_SFD_CHIRPS*OVERLAP_FACTOR; i++)
-            {
-              if (abs(int(d_sfd_idx) - int(d_sfd_history[i])) > d_fft_size_factor*LORA_SFD_TOLERANCE)
-              {
-                sfd_found = false;
-              }
-            }
+            sfd_found = d_sfd_history.within_tolerance(d_fft_size_factor*LORA_SFD_TOLERANCE);
 
             // If within tolerance, we've found the SFD and are synchronized
             if (sfd_found)
@@ -344,7 +629,23 @@ namespace gr {
               num_consumed = (ol*d_num_symbols)/d_overlaps + 5*d_num_symbols/4;   // Skip last quarter chirp
               d_offset = (d_offset + (d_num_symbols/4)) % d_num_symbols;
 
+              float preamble_pos = (float)d_preamble_idx/d_fft_size_factor + d_preamble_frac;
+              float sfd_pos      = (max_index + peak_offset(d_fft_mag, d_fft_size, max_index))/d_fft_size_factor;
+              split_sync_offsets(preamble_pos, sfd_pos, d_num_symbols, d_cfo, d_sto);
+
+              // Data symbols are measured against the whole preamble bin; cancel its fractional part in the dechirp table
+              d_track_offset = d_preamble_frac;
+              compensate_downchirp(d_preamble_frac);
+
               d_state = S_READ_HEADER;
+              d_packet_id++;
+
+              // Every stream PDU of this packet shares its metadata; each symbol only adds its index
+              if (d_stream)
+              {
+                d_stream_meta = pmt::dict_add(pmt::make_dict(), PDU_KEY_SF, pmt::from_long(d_sf));
+                d_stream_meta = pmt::dict_add(d_stream_meta, PDU_KEY_PACKET, pmt::from_uint64(d_packet_id));
+              }
               d_overlaps = OVERLAP_DEFAULT;
 
               #if DEBUG >= DEBUG_INFO
@@ -379,10 +680,29 @@ namespace gr {
         }
 
         /* Preamble + modulo operation normalizes the symbols about the preamble; preamble symbol == value 0
-         * Dividing by d_fft_size_factor reduces symbols to [0:(2**sf)-1] range
+         * Dividing by d_fft_size_factor (rounding) reduces symbols to [0:(2**sf)-1] range
          * Dividing by 4 to further reduce symbol set to [0:(2**(sf-2)-1)], since header is sent at SF-2
          */
-        d_symbols.push_back( ( ( d_num_symbols + (d_argmax_history[0]/d_fft_size_factor) - (d_preamble_idx/d_fft_size_factor)) % d_num_symbols) / 4);
+        d_symbols.push_back(normalize(d_argmax_history[0]) / 4);
+        if (d_soft_decoding) soft_candidates(true);
+        track_offset(max_index);
+        if (d_stream) stream_symbol();
+
+        // The header block is complete; a short packet may end with it
+        if (d_header && d_state == S_READ_PAYLOAD)
+        {
+          read_header();
+
+          if (d_symbols.size() >= d_packet_symbols)
+          {
+            publish_packet();
+            d_state = S_RESET;
+
+            #if DEBUG >= DEBUG_INFO
+              std::cout << "Next state: S_RESET" << std::endl;
+            #endif
+          }
+        }
 
         break;
 
@@ -399,15 +719,29 @@ namespace gr {
         }
 
         /* Preamble + modulo operation normalizes the symbols about the preamble; preamble symbol == value 0
-         * Dividing by d_fft_size_factor reduces symbols to [0:(2**sf)-1] range
+         * Dividing by d_fft_size_factor (rounding) reduces symbols to [0:(2**sf)-1] range
          */
         if (d_ldr)  // if low data rate optimization is on, give entire packet the header treatment of ppm == SF-2
         {
-          d_symbols.push_back( ( ( d_num_symbols + (d_argmax_history[0]/d_fft_size_factor) - (d_preamble_idx/d_fft_size_factor)) % d_num_symbols) / 4);
+          d_symbols.push_back(normalize(d_argmax_history[0]) / 4);
         }
         else
         {
-          d_symbols.push_back( ( d_num_symbols + (d_argmax_history[0]/d_fft_size_factor) - (d_preamble_idx/d_fft_size_factor)) % d_num_symbols);  
+          d_symbols.push_back(normalize(d_argmax_history[0]));
+        }
+        if (d_soft_decoding) soft_candidates(d_ldr);
+        track_offset(max_index);
+        if (d_stream) stream_symbol();
+
+        // Stop on the last symbol once an explicit header has given the packet length
+        if (d_packet_symbols && d_symbols.size() >= d_packet_symbols)
+        {
+          publish_packet();
+          d_state = S_RESET;
+
+          #if DEBUG >= DEBUG_INFO
+            std::cout << "Next state: S_RESET" << std::endl;
+          #endif
         }
 
         break;
@@ -417,9 +751,7 @@ namespace gr {
       // Emit a PDU to the decoder
       case S_OUT:
       {
-        pmt::pmt_t output = pmt::init_u16vector(d_symbols.size(), d_symbols);
-        pmt::pmt_t msg_pair = pmt::cons(pmt::make_dict(), output);
-        message_port_pub(d_out_port, msg_pair);
+        publish_packet();
 
         d_state = S_RESET;
 
@@ -440,11 +772,39 @@ namespace gr {
         f_raw.write((const char*)&in[0], num_consumed*sizeof(gr_complex));
       #endif
 
-      consume_each (num_consumed);
+      return num_consumed;
+    }
 
-      free(down_block);
-      free(up_block);
-      free(buffer);
+    int
+    demod_impl::general_work (int noutput_items,
+                       gr_vector_int &ninput_items,
+                       gr_vector_const_void_star &input_items,
+                       gr_vector_void_star &output_items)
+    {
+      const gr_complex *in = (const gr_complex *)  input_items[0];
+      int num_consumed = 0;
+
+      // Walk every complete symbol window available, advancing the state machine once per symbol.
+      // History keeps DEMOD_HISTORY_DEPTH chirps of lookahead valid past the last window.
+      // A successful SFD sync may consume up to 2.25 chirps in one step, so require that much before syncing.
+      while (num_consumed + d_oversampling*((d_state == S_SFD_SYNC) ? (9*d_num_symbols)/4 : d_num_symbols) <= ninput_items[0])
+      {
+        if (d_oversampling > 1)
+        {
+          // Overlapped SFD FFTs read up to two chirps from the start of the window; everything else reads one
+          d_decimator->filterNdec(d_decim, &in[num_consumed],
+                                  (d_state == S_SFD_SYNC) ? 2*d_num_symbols : d_num_symbols,
+                                  d_oversampling);
+
+          num_consumed += d_oversampling*demod_symbol(d_decim);
+        }
+        else
+        {
+          num_consumed += demod_symbol(&in[num_consumed]);
+        }
+      }
+
+      consume_each (num_consumed);
 
       return noutput_items;
     }
@@ -23,14 +23,19 @@
 
 #include <cmath>
 #include <cstdlib>
+#include <new>
 #include <vector>
 #include <queue>
 #include <complex>
 #include <fstream>
 #include <gnuradio/fft/fft.h>
 #include <gnuradio/fft/window.h>
+#include <gnuradio/filter/fir_filter.h>
+#include <gnuradio/filter/firdes.h>
+#include <fftw3.h>
 #include <volk/volk.h>
 #include "lora/demod.h"
+#include "symbol_history.h"
 
 namespace gr {
   namespace lora {
@@ -39,6 +44,9 @@ namespace gr {
     {
      private:
       pmt::pmt_t d_out_port;
+      pmt::pmt_t d_stream_port;
+      pmt::pmt_t d_stream_meta;     // Metadata shared by the current packet's stream PDUs
+      pmt::pmt_t d_stream_end;      // Empty payload of the end-of-packet marker
 
       demod_state_t   d_state;
       unsigned short  d_sf;
@@ -51,16 +59,33 @@ namespace gr {
       unsigned short  d_offset;
 
       float           d_power;
+      float           d_noise_floor;
       float           d_threshold;
       bool            d_squelched;
 
       unsigned short  d_preamble_idx;
       unsigned short  d_sfd_idx;
-      std::vector<unsigned short>  d_argmax_history;
-      std::vector<unsigned short>  d_sfd_history;
+      float           d_preamble_frac;      // Sub-bin part of the preamble peak, in symbol bins
+      float           d_cfo;                // Carrier frequency offset estimated from the preamble and SFD, in symbol bins
+      float           d_sto;                // Symbol timing offset estimated from the preamble and SFD, in chips
+      float           d_track_offset;       // Fractional frequency offset tracked across the packet's data symbols, in symbol bins
+      float           d_applied_offset;     // Offset d_compensated_downchirp currently corrects for
+      symbol_history  d_argmax_history;
+      symbol_history  d_sfd_history;
       unsigned short  d_sync_recovery_counter;
 
       fft::fft_complex   *d_fft;
+      bool                d_batch_sync;
+      unsigned short      d_oversampling;
+      bool                d_soft_decoding;
+      bool                d_header;
+      unsigned char       d_header_hamming[256];   // rdd 4 Hamming decoding table for the explicit header block
+      bool                d_stream;
+      filter::kernel::fir_filter_ccf *d_decimator;
+      gr_complex         *d_decim;
+      fftwf_plan          d_sync_plan;
+      gr_complex         *d_sync_in;
+      gr_complex         *d_sync_out;
       std::vector<float> d_window;
       float              d_beta;
 
@@ -68,17 +93,47 @@ namespace gr {
       std::vector<gr_complex> d_downchirp;
 
       std::vector<unsigned short> d_symbols;
-
+      std::vector<unsigned short> d_soft_symbols;       // SOFT_CANDIDATES strongest values per symbol, strongest first
+      std::vector<float>          d_soft_magnitudes;    // Bin power of each candidate
+      std::vector<float>          d_soft_noise;         // Mean bin power excluding the peak, per symbol
+      unsigned long               d_packet_id;        // Counts packets, so stream symbols can be matched to theirs
+      unsigned int                d_packet_symbols;   // Symbol count from the decoded explicit header, 0 until known
+
+      // Aligned scratch buffers, allocated once at construction and reused by every call to general_work
+      float          *d_fft_mag;
+      gr_complex     *d_windowed_downchirp;
+      gr_complex     *d_compensated_downchirp;
+      float          *d_soft_energy;
+
+      void *alloc_scratch(size_t num_bytes);
+
+      // IQ dump state, only allocated and opened when DUMP_IQ is enabled
+      gr_complex     *d_up_block;
+      gr_complex     *d_down_block;
       std::ofstream f_raw, f_up_windowless, f_up, f_down;
 
      public:
       demod_impl( unsigned short spreading_factor,
                   bool low_data_rate,
                   float beta,
-                  unsigned short fft_factor);
+                  unsigned short fft_factor,
+                  bool  batch_sync,
+                  unsigned short oversampling,
+                  bool  soft_decoding,
+                  bool  header,
+                  bool  stream);
       ~demod_impl();
 
       unsigned short argmax(gr_complex *fft_result, bool update_squelch);
+      unsigned short normalize(unsigned short bin);
+      void           compensate_downchirp(float offset);
+      void           track_offset(unsigned short max_idx);
+      unsigned int   demod_symbol(const gr_complex *in);
+      const gr_complex *windowed_downchirp(unsigned short offset);
+      void           soft_candidates(bool reduced_rate);
+      void           stream_symbol();
+      void           publish_packet();
+      void           read_header();
 
       // Where all the action really happens
       void forecast (int noutput_items, gr_vector_int &ninput_items_required);
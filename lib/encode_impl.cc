@@ -23,14 +23,12 @@
 #endif
 
 #include <gnuradio/io_signature.h>
+#include <algorithm>
 #include "encode_impl.h"
-
-#define HAMMING_P1_BITMASK 0x0D  // 0b00001101
-#define HAMMING_P2_BITMASK 0x0B  // 0b00001011
-#define HAMMING_P4_BITMASK 0x07  // 0b00000111
-#define HAMMING_P8_BITMASK 0xFF  // 0b11111111
-
-#define INTERLEAVER_BLOCK_SIZE 8
+#include "hamming.h"
+#include "interleaver.h"
+#include "phy_header.h"
+#include "crc16.h"
 
 #define DEBUG_OUTPUT 0  // Controls debug print statements
 
@@ -41,10 +39,11 @@ namespace gr {
     encode::make( short spreading_factor,
                   short code_rate,
                   bool  low_data_rate,
-                  bool  header)
+                  bool  header,
+                  bool  crc)
     {
       return gnuradio::get_initial_sptr
-        (new encode_impl(spreading_factor, code_rate, low_data_rate, header));
+        (new encode_impl(spreading_factor, code_rate, low_data_rate, header, crc));
     }
 
     /*
@@ -53,14 +52,16 @@ namespace gr {
     encode_impl::encode_impl( short spreading_factor,
                               short code_rate,
                               bool  low_data_rate,
-                              bool  header)
+                              bool  header,
+                              bool  crc)
       : gr::block("encode",
               gr::io_signature::make(0, 0, 0),
               gr::io_signature::make(0, 0, 0)),
         d_sf(spreading_factor),
         d_cr(code_rate),
         d_ldr(low_data_rate),
-        d_header(header)
+        d_header(header),
+        d_crc(crc)
     {
       assert((d_sf > 5) && (d_sf < 13));
       assert((d_cr > 0) && (d_cr < 5));
@@ -112,13 +113,27 @@ namespace gr {
 
       if (d_header)
       {
-        std::cout << "Warning: Explicit header mode is not yet supported." << std::endl;
-        std::cout << "         Using an implicit whitening sequence: modulation will work correctly; encoding will not." << std::endl;
+        std::cout << "Warning: No explicit header whitening sequence is known; the payload is whitened with the implicit sequence." << std::endl;
       }
 
       d_interleaver_size = d_sf;
 
       d_fft_size = (1 << spreading_factor);
+
+      // Encode every possible nybble once, for every code rate
+      for (int rdd = 1; rdd <= MAXIMUM_RDD; rdd++)
+      {
+        hamming_build_encode_table(d_hamming_table[rdd-1], rdd);
+      }
+
+      crc16_build_table(d_crc_table);
+
+      // Size the scratch buffers for the longest explicit header packet up front; longer implicit payloads grow them once
+      unsigned char payload_ppm = d_ldr ? (d_sf-2) : d_sf;
+      size_t max_nybbles = (d_sf-2) + 2*(255 + CRC16_BYTES) + PHY_HEADER_NYBBLES + payload_ppm;
+      d_nybbles.reserve(max_nybbles);
+      d_codewords.reserve(max_nybbles);
+      d_symbols.reserve(phy_packet_symbols(d_sf, 255, MAXIMUM_RDD, true, d_ldr));
     }
 
     /*
@@ -129,18 +144,18 @@ namespace gr {
     }
 
     void
-    encode_impl::to_gray(std::vector<unsigned short> &symbols)
+    encode_impl::to_gray(unsigned short *symbols, size_t num_symbols)
     {
-      for (int i = 0; i < symbols.size(); i++)
+      for (size_t i = 0; i < num_symbols; i++)
       {
         symbols[i] = (symbols[i] >> 1) ^ symbols[i];
       }
     }
 
     void
-    encode_impl::from_gray(std::vector<unsigned short> &symbols)
+    encode_impl::from_gray(unsigned short *symbols, size_t num_symbols)
     {
-      for (int i = 0; i < symbols.size(); i++)
+      for (size_t i = 0; i < num_symbols; i++)
       {
         symbols[i] = symbols[i] ^ (symbols[i] >> 16);
         symbols[i] = symbols[i] ^ (symbols[i] >>  8);
@@ -151,11 +166,15 @@ namespace gr {
     }
 
     void
-    encode_impl::whiten(std::vector<unsigned short> &symbols)
+    encode_impl::whiten(unsigned short *symbols, size_t num_symbols, size_t offset)
     {
-      for (int i = 0; i < symbols.size() && i < whitening_sequence_length; i++)
+      // offset is the position of symbols[0] within the packet
+      // Symbols and whitening words are up to d_sf bits wide, so they must not be truncated to a byte
+      const unsigned short mask = (1 << d_sf) - 1;
+
+      for (size_t i = 0; i < num_symbols && i + offset < whitening_sequence_length; i++)
       {
-        symbols[i] = ((unsigned char)(symbols[i] & 0xFF) ^ d_whitening_sequence[i]) & 0xFF;
+        symbols[i] = (symbols[i] ^ d_whitening_sequence[i + offset]) & mask;
       }
     }
 
@@ -179,132 +198,6 @@ namespace gr {
       }
     }
 
-    // Forward interleaver dimensions:
-    //  PPM   == number of bits per symbol OUT of interleaver        AND number of codewords IN to interleaver
-    //  RDD+4 == number of bits per codeword IN to interleaver       AND number of interleaved codewords OUT of interleaver
-    //
-    // bit width in:  (4+rdd)   block length: ppm
-    // bit width out: ppm       block length: (4+rdd)
-    void
-    encode_impl::interleave(std::vector <unsigned char> &codewords,
-                            std::vector <unsigned short> &symbols,
-                            unsigned char ppm,
-                            unsigned char rdd)
-    {
-      int bit_offset     = 0;
-      int bit_idx        = 0;
-      unsigned char block[INTERLEAVER_BLOCK_SIZE];    // maximum bit-width is 8, should RDD==4
-      unsigned char reordered[INTERLEAVER_BLOCK_SIZE];
-
-      // Block interleaver: interleave PPM codewords at a time into 4+RDD codewords
-      for (int block_count = 0; block_count < codewords.size()/ppm; block_count++)
-      {
-
-        memset(block, 0, INTERLEAVER_BLOCK_SIZE*sizeof(unsigned char));
-        bit_idx = 0;
-        bit_offset = 0;
-
-        if (ppm == 6)
-        {
-          reordered[4] = codewords[0 + block_count*ppm];
-          reordered[5] = codewords[1 + block_count*ppm];
-          reordered[2] = codewords[2 + block_count*ppm];
-          reordered[3] = codewords[3 + block_count*ppm];
-          reordered[0] = codewords[4 + block_count*ppm];
-          reordered[1] = codewords[5 + block_count*ppm];
-        }
-        else if (ppm == 8)
-        {
-          reordered[0] = codewords[0 + block_count*ppm];
-          reordered[7] = codewords[1 + block_count*ppm];
-          reordered[2] = codewords[2 + block_count*ppm];
-          reordered[1] = codewords[3 + block_count*ppm];
-          reordered[4] = codewords[4 + block_count*ppm];
-          reordered[3] = codewords[5 + block_count*ppm];
-          reordered[6] = codewords[6 + block_count*ppm];
-          reordered[5] = codewords[7 + block_count*ppm];
-        }
-
-        // Iterate through each bit in the interleaver block
-        for (int bitcount = 0; bitcount < ppm*(4+rdd); bitcount++)
-        {
-
-          if (reordered[(bitcount / (4+rdd)) /*+ ppm*block_count*/] & 0x1 << (bitcount % (4+rdd)))
-          {
-            block[bitcount % (4+rdd)] |= ((0x1 << (ppm-1)) >> ((bit_idx + bit_offset) % ppm));   // integer divison in C++ is defined to floor
-          }
-
-          // bit idx walks through diagonal interleaving pattern
-          if (bitcount % (4+rdd) == (4+rdd-1))
-          {
-            bit_idx = 0;
-            bit_offset++;
-          }
-          else
-          {
-            bit_idx++;
-          }
-        }
-
-        for (int block_idx = 0; block_idx < (4+rdd); block_idx++)
-        {
-          symbols.push_back(block[block_idx]);
-        }
-      }
-
-      // Swap MSBs of each symbol within buffer (one of LoRa's quirks)
-      for (int symbol_idx = 0; symbol_idx < symbols.size(); symbol_idx++)
-      {
-        symbols[symbol_idx] = ( (symbols[symbol_idx] &  (0x1 << (ppm-1))) >> 1 |
-                                (symbols[symbol_idx] &  (0x1 << (ppm-2))) << 1 |
-                                (symbols[symbol_idx] & ((0x1 << (ppm-2)) - 1))
-                              );
-      }
-    }
-
-    void
-    encode_impl::hamming_encode(std::vector<unsigned char> &nybbles,
-                                std::vector<unsigned char> &codewords,
-                                unsigned char rdd)
-    {
-      unsigned char p1, p2, p4, p8;
-      unsigned char mask;
-
-      for (int i = 0; i < nybbles.size(); i++)
-      {
-        p1 = parity((unsigned char)nybbles[i], mask = (unsigned char)HAMMING_P1_BITMASK);
-        p2 = parity((unsigned char)nybbles[i], mask = (unsigned char)HAMMING_P2_BITMASK);
-        p4 = parity((unsigned char)nybbles[i], mask = (unsigned char)HAMMING_P4_BITMASK);
-        p8 = parity((unsigned char)nybbles[i] | p1 << 7 | p2 << 6 | p4 << 4, 
-                      mask = (unsigned char)HAMMING_P8_BITMASK);
-
-        codewords.push_back(( (p1 << 7) |
-                              (p2 << 6) |
-                              (p8 << 5) |
-                              (p4 << 4) |
-                              (nybbles[i] & 0x08) | 
-                              (nybbles[i] & 0x04) |
-                              (nybbles[i] & 0x02) |
-                              (nybbles[i] & 0x01)   ));
-
-      }
-    }
-
-    unsigned char
-    encode_impl::parity(unsigned char c, unsigned char bitmask)
-    {
-      unsigned char parity = 0;
-      unsigned char shiftme = c & bitmask;
-
-      for (int i = 0; i < 8; i++)
-      {
-        if (shiftme & 0x1) parity++;
-        shiftme = shiftme >> 1;
-      }
-
-      return parity % 2;
-    }
-
     void
     encode_impl::print_payload(std::vector<unsigned char> &payload)
     {
@@ -324,100 +217,98 @@ namespace gr {
       size_t pkt_len(0);
       const uint8_t* bytes_in = pmt::u8vector_elements(bytes, pkt_len);
 
-      std::vector<unsigned char>  nybbles;
-      std::vector<unsigned char>  header_nybbles;
-      std::vector<unsigned char>  payload_nybbles;
-      std::vector<unsigned char>  header_codewords;
-      std::vector<unsigned char>  payload_codewords;
-      std::vector<unsigned short> header_symbols;
-      std::vector<unsigned short> payload_symbols;
-      std::vector<unsigned short> symbols;
+      if (d_header && pkt_len > 255)
+      {
+        std::cerr << "Payload of " << pkt_len << " bytes does not fit an explicit header; dropping it." << std::endl;
+        return;
+      }
+
+      unsigned char payload_ppm = d_ldr ? (d_sf-2) : d_sf;
+      size_t num_header_nybbles = d_header ? PHY_HEADER_NYBBLES : 0;
+      size_t num_data_nybbles   = num_header_nybbles + 2*pkt_len + (d_crc ? 2*CRC16_BYTES : 0);
+
+      // Zero-pad to a whole header block plus whole payload blocks, so no trailing nybbles are lost by the interleaver
+      size_t header_len  = d_sf-2;
+      size_t payload_len = (num_data_nybbles > header_len) ? num_data_nybbles - header_len : 0;
+      payload_len = ((payload_len + payload_ppm - 1) / payload_ppm) * payload_ppm;
+
+      size_t num_payload_symbols = (payload_len/payload_ppm)*(4+d_cr);
+      size_t num_symbols         = PHY_HEADER_SYMBOLS + num_payload_symbols;
+
+      d_nybbles.assign(header_len + payload_len, 0);
+      d_codewords.resize(header_len + payload_len);
+      d_symbols.resize(num_symbols);
 
       if (d_header)
       {
-        nybbles.push_back(0xF);
-        nybbles.push_back(0xF);
-        nybbles.push_back(0xF);
-        nybbles.push_back(0xF);
-        nybbles.push_back(0xF);
-        nybbles.push_back(0xF);
-        nybbles.push_back(0xF);
-        nybbles.push_back(0xF);
+        d_nybbles[0] = (pkt_len >> 4) & 0x0F;
+        d_nybbles[1] = pkt_len & 0x0F;
+        d_nybbles[2] = (d_cr << 1) | (d_crc ? 0x1 : 0x0);
+
+        unsigned char checksum = phy_header_checksum(&d_nybbles[0]);
+        d_nybbles[3] = checksum >> 4;
+        d_nybbles[4] = checksum & 0x0F;
       }
 
       // split bytes into separate data nybbles
       for (int i = 0; i < pkt_len; i++)
       {
-        nybbles.push_back((bytes_in[i] & 0xF0) >> 4);
-        nybbles.push_back((bytes_in[i] & 0x0F));
+        d_nybbles[num_header_nybbles + 2*i]     = (bytes_in[i] & 0xF0) >> 4;
+        d_nybbles[num_header_nybbles + 2*i + 1] = (bytes_in[i] & 0x0F);
       }
 
-      // allocate nybbles to header or payload based on modulation parameters
-      for (int i = 0; i < nybbles.size(); i++)
+      // CRC-16 of the payload follows it, MSB first
+      if (d_crc)
       {
-        if (i < (d_sf-2)) // header
-        {
-          header_nybbles.push_back(nybbles[i]);
-        }
-        else // payload
-        {
-          payload_nybbles.push_back(nybbles[i]);
-        }
+        unsigned short crc = CRC16_INITIAL;
+        for (int i = 0; i < pkt_len; i++) crc = crc16_update(d_crc_table, crc, bytes_in[i]);
+
+        size_t crc_idx = num_header_nybbles + 2*pkt_len;
+        d_nybbles[crc_idx]     = (crc >> 12) & 0x0F;
+        d_nybbles[crc_idx + 1] = (crc >>  8) & 0x0F;
+        d_nybbles[crc_idx + 2] = (crc >>  4) & 0x0F;
+        d_nybbles[crc_idx + 3] =  crc        & 0x0F;
       }
 
       #if DEBUG_OUTPUT
-        std::cout << "Header Nybbles:" << std::endl;
-        print_bitwise_u8(header_nybbles);
-        std::cout << "Payload Nybbles:" << std::endl;
-        print_bitwise_u8(payload_nybbles);
-      #endif
-
-      // Encode header
-      hamming_encode(header_nybbles, header_codewords, 4);
-      #if DEBUG_OUTPUT
-        std::cout << "Header Codewords:" << std::endl;
-        print_bitwise_u8(header_codewords);
-      #endif
-
-      interleave(header_codewords, header_symbols, d_sf-2, 4);
-      #if DEBUG_OUTPUT
-        std::cout << "Header Symbols:" << std::endl;
-        print_bitwise_u16(header_symbols);
+        std::cout << "Nybbles:" << std::endl;
+        print_bitwise_u8(d_nybbles);
       #endif
 
-      // Encode payload
-      hamming_encode(payload_nybbles, payload_codewords, d_cr);
+      // Encode header and payload
+      hamming_encode(d_hamming_table[PHY_MAX_CR-1], &d_nybbles[0], &d_codewords[0], header_len);
+      if (payload_len > 0) hamming_encode(d_hamming_table[d_cr-1], &d_nybbles[header_len], &d_codewords[header_len], payload_len);
       #if DEBUG_OUTPUT
-        std::cout << "Payload Codewords:" << std::endl;
-        print_bitwise_u8(payload_codewords);
+        std::cout << "Codewords:" << std::endl;
+        print_bitwise_u8(d_codewords);
       #endif
 
-      interleave(payload_codewords, payload_symbols, d_ldr ? (d_sf-2) : d_sf, d_cr);
+      interleave_codewords(&d_codewords[0], header_len, d_sf-2, PHY_MAX_CR, &d_symbols[0]);
+      if (payload_len > 0) interleave_codewords(&d_codewords[header_len], payload_len, payload_ppm, d_cr, &d_symbols[PHY_HEADER_SYMBOLS]);
       #if DEBUG_OUTPUT
-        std::cout << "Payload Symbols:" << std::endl;
-        print_bitwise_u16(payload_symbols);
+        std::cout << "Interleaved Symbols:" << std::endl;
+        print_bitwise_u16(d_symbols);
       #endif
 
-      // Combine symbol vectors
-      symbols.insert(symbols.begin(), header_symbols.begin(), header_symbols.end());
-      symbols.insert(symbols.end(), payload_symbols.begin(), payload_symbols.end());
+      // An explicit header is sent without whitening
+      if (!d_header) whiten(&d_symbols[0], PHY_HEADER_SYMBOLS);
+      whiten(&d_symbols[PHY_HEADER_SYMBOLS], num_payload_symbols, PHY_HEADER_SYMBOLS);
 
-      whiten(symbols);
-      from_gray(symbols);
+      from_gray(&d_symbols[0], num_symbols);
 
       // Expand symbol mapping for header or full packet if LDR enabled
-      int ldr_limit = d_ldr ? symbols.size() : 8;
-      for (int i = 0; i < symbols.size() && i < ldr_limit; i++)
+      size_t ldr_limit = d_ldr ? num_symbols : PHY_HEADER_SYMBOLS;
+      for (size_t i = 0; i < ldr_limit; i++)
       {
-        symbols[i] <<= 2;
+        d_symbols[i] <<= 2;
       }
 
       #if DEBUG_OUTPUT
         std::cout << "Modulated Symbols: " << std::endl;
-        print_bitwise_u16(symbols);
+        print_bitwise_u16(d_symbols);
       #endif
 
-      pmt::pmt_t output = pmt::init_u16vector(symbols.size(), symbols);
+      pmt::pmt_t output = pmt::init_u16vector(num_symbols, &d_symbols[0]);
       pmt::pmt_t msg_pair = pmt::cons(pmt::make_dict(), output);
 
       message_port_pub(d_out_port, msg_pair);
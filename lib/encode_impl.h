@@ -23,8 +23,11 @@
 
 #include <volk/volk.h>
 #include <bitset>
+#include <vector>
 #include <lora/encode.h>
 
+#define MAXIMUM_RDD 4
+
 namespace gr {
   namespace lora {
 
@@ -40,23 +43,32 @@ namespace gr {
       unsigned char d_cr;
       bool          d_ldr;
       bool          d_header;
+      bool          d_crc;          // Append a payload CRC-16, flagged in the explicit header if there is one
 
       unsigned short d_fft_size;
       unsigned char  d_interleaver_size;
 
+      // Codeword for every data nybble, masked to 4+rdd bits, indexed [rdd-1][nybble]
+      unsigned char d_hamming_table[MAXIMUM_RDD][16];
+
+      // Scratch buffers reused by every PDU, sized for the longest explicit header packet at construction
+      std::vector<unsigned char>  d_nybbles;
+      std::vector<unsigned char>  d_codewords;
+      std::vector<unsigned short> d_symbols;
+
+      unsigned short d_crc_table[256];
+
      public:
       encode_impl(  short spreading_factor,
                     short code_rate,
                     bool  low_data_rate,
-                    bool  header);
+                    bool  header,
+                    bool  crc);
       ~encode_impl();
 
-      void to_gray(std::vector<unsigned short> &symbols);
-      void from_gray(std::vector<unsigned short> &symbols);
-      void whiten(std::vector<unsigned short> &symbols);
-      void interleave(std::vector<unsigned char> &codewords, std::vector<unsigned short> &symbols, unsigned char ppm, unsigned char rdd);
-      void hamming_encode(std::vector<unsigned char> &nybbles, std::vector<unsigned char> &codewords, unsigned char rdd);
-      unsigned char parity(unsigned char c, unsigned char bitmask);
+      void to_gray(unsigned short *symbols, size_t num_symbols);
+      void from_gray(unsigned short *symbols, size_t num_symbols);
+      void whiten(unsigned short *symbols, size_t num_symbols, size_t offset = 0);
       void print_payload(std::vector<unsigned char> &payload);
 
       void print_bitwise_u8 (std::vector<unsigned char>  &buffer);
@@ -0,0 +1,56 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_FFT_PEAK_H
+#define INCLUDED_LORA_FFT_PEAK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <complex>
+#include <volk/volk.h>
+
+namespace gr {
+  namespace lora {
+
+    /*
+     * Peak search over an FFT output: writes the power of every bin to mag, and
+     * returns the index of the strongest bin along with the total power of all
+     * bins, from which the demodulator derives its noise floor.  Ties go to the
+     * lowest index.
+     */
+    inline uint32_t
+    fft_peak(const std::complex<float> *fft_result,
+             float *mag,
+             size_t n,
+             float &total_power)
+    {
+      uint32_t max_idx;
+
+      volk_32fc_magnitude_squared_32f(mag, fft_result, n);
+      volk_32f_index_max_32u(&max_idx, mag, n);
+      volk_32f_accumulator_s32f(&total_power, mag, n);
+
+      return max_idx;
+    }
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_FFT_PEAK_H */
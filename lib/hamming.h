@@ -0,0 +1,201 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_HAMMING_H
+#define INCLUDED_LORA_HAMMING_H
+
+#include <stddef.h>
+
+#define HAMMING_ERROR_FLAG 0x10   // Set in a decoding table entry when the received codeword fails a parity check
+
+namespace gr {
+  namespace lora {
+
+    /*
+     * Hamming(4+rdd,4) decoding of deinterleaved codewords, in the traditional
+     * Hamming bit order produced by the deinterleaver:
+     *
+     *  rdd 4: p1 p2 d3 p4 d2 d1 d0 p8     (p8 is even parity over all 8 bits)
+     *  rdd 3:    p1 p2 d3 p4 d2 d1 d0
+     *  rdd 2:       p8 p4 d3 d2 d1 d0
+     *  rdd 1:          p4 d3 d2 d1 d0
+     *
+     * Codewords are decoded once per code rate into a 256-entry table at
+     * construction, so the per-codeword cost is a single lookup.
+     */
+
+    inline unsigned char
+    hamming_parity(unsigned char c, unsigned char bitmask)
+    {
+      c &= bitmask;
+      c ^= c >> 4;
+      c ^= c >> 2;
+      c ^= c >> 1;
+
+      return c & 0x1;
+    }
+
+    // Whether codeword fails any parity check of the code sent at this rate
+    inline bool
+    hamming_syndrome(unsigned char codeword, unsigned char rdd)
+    {
+      // One bitmask per parity check, each covering a parity bit and the bits it protects
+      static const unsigned char checks[4][4] = {
+        { 0x17, 0x00, 0x00, 0x00 },     // rdd 1: p4
+        { 0x17, 0x2E, 0x00, 0x00 },     // rdd 2: p4, p8
+        { 0x55, 0x33, 0x0F, 0x00 },     // rdd 3: p1, p2, p4
+        { 0xAA, 0x66, 0x1E, 0xFF },     // rdd 4: p1, p2, p4, p8
+      };
+
+      unsigned char failed = 0;
+      for (int i = 0; i < 4; i++)
+      {
+        failed |= hamming_parity(codeword, checks[rdd-1][i]);
+      }
+
+      return failed;
+    }
+
+    // Reference decoder for a single codeword, used to build the lookup tables
+    // Returns the corrected data nybble, with HAMMING_ERROR_FLAG set if the codeword had a nonzero syndrome
+    inline unsigned char
+    hamming_decode_codeword(unsigned char codeword, unsigned char rdd)
+    {
+      unsigned char p1 = 0, p2 = 0, p4 = 0;
+      unsigned int  num_set_bits;
+      int           error_pos;
+      bool          error = hamming_syndrome(codeword, rdd);
+
+      switch (rdd) {
+        case 4:
+        case 3:
+          p4 = hamming_parity(codeword, 0x1E >> (4 - rdd));
+        case 2:
+          p2 = hamming_parity(codeword, 0x66 >> (4 - rdd));
+        case 1:
+          p1 = hamming_parity(codeword, 0xAA >> (4 - rdd));
+          break;
+      }
+
+      error_pos = -1;
+      if (p1 != 0) error_pos += 1;
+      if (p2 != 0) error_pos += 2;
+      if (p4 != 0) error_pos += 4;
+
+      // Hamming(4+rdd,4) is only corrective if rdd >= 3
+      if (rdd > 2)
+      {
+        num_set_bits = 0;
+        for (int bit_idx = 0; bit_idx < 8; bit_idx++)
+        {
+          if (codeword & (0x01 << bit_idx))
+          {
+            num_set_bits++;
+          }
+        }
+
+        if (error_pos >= 0 && num_set_bits < 6 && num_set_bits > 2)
+        {
+          codeword ^= (0x80 >> (4-rdd)) >> error_pos;
+        }
+      }
+
+      switch (rdd)
+      {
+        case 1:
+        case 2:
+          codeword = codeword & 0x0F;
+          break;
+        case 3:
+          codeword = (((codeword & 0x10) >> 1) | \
+                      ((codeword & 0x04))      | \
+                      ((codeword & 0x02))      | \
+                      ((codeword & 0x01))) & 0x0F;
+          break;
+        case 4:
+          codeword = (((codeword & 0x20) >> 2) | \
+                      ((codeword & 0x08) >> 1) | \
+                      ((codeword & 0x04) >> 1) | \
+                      ((codeword & 0x02) >> 1)) & 0x0F;
+          break;
+      }
+
+      return (codeword & 0x0F) | (error ? HAMMING_ERROR_FLAG : 0);
+    }
+
+    // Fills table with the decoded nybble (plus HAMMING_ERROR_FLAG) of every raw codeword at this rate
+    inline void
+    hamming_build_table(unsigned char *table, unsigned char rdd)
+    {
+      for (int codeword = 0; codeword < 256; codeword++)
+      {
+        table[codeword] = hamming_decode_codeword(codeword, rdd);
+      }
+    }
+
+    // Codeword the encoder sends for a nybble, in the bit layout the deinterleaver produces before its Hamming reordering:
+    //
+    //  rdd 4: p1 p2 p8 p4 d3 d2 d1 d0
+    //  rdd 3:    p1 p2 p4 d3 d2 d1 d0
+    //  rdd 2:          p8 p4 d3 d2 d1 d0
+    //  rdd 1:             p4 d3 d2 d1 d0
+    inline unsigned char
+    hamming_encode_nybble(unsigned char nybble, unsigned char rdd)
+    {
+      unsigned char p1 = hamming_parity(nybble, 0x0D);
+      unsigned char p2 = hamming_parity(nybble, 0x0B);
+      unsigned char p4 = hamming_parity(nybble, 0x07);
+      unsigned char p8 = hamming_parity(nybble | p1 << 7 | p2 << 6 | p4 << 4, 0xFF);
+      unsigned char codeword;
+
+      // Hamming(7,4) carries p1, p2 and p4, which is what the decoder corrects against; drop p8 rather than p1
+      if (rdd == 3) codeword = (p1 << 6) | (p2 << 5) | (p4 << 4) | (nybble & 0x0F);
+      else          codeword = (p1 << 7) | (p2 << 6) | (p8 << 5) | (p4 << 4) | (nybble & 0x0F);
+
+      return codeword & ((1 << (4+rdd)) - 1);
+    }
+
+    // Fills table with the codeword of every data nybble at this rate
+    inline void
+    hamming_build_encode_table(unsigned char *table, unsigned char rdd)
+    {
+      for (int nybble = 0; nybble < 16; nybble++)
+      {
+        table[nybble] = hamming_encode_nybble(nybble, rdd);
+      }
+    }
+
+    // Encodes num_nybbles nybbles into the caller's codewords buffer, one lookup in a table from hamming_build_encode_table each
+    inline void
+    hamming_encode(const unsigned char *table,
+                   const unsigned char *nybbles,
+                   unsigned char *codewords,
+                   size_t num_nybbles)
+    {
+      for (size_t i = 0; i < num_nybbles; i++)
+      {
+        codewords[i] = table[nybbles[i] & 0x0F];
+      }
+    }
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_HAMMING_H */
@@ -0,0 +1,103 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_LORA_INTERLEAVER_H
+#define INCLUDED_LORA_INTERLEAVER_H
+
+#include <stddef.h>
+#include "bit_transpose.h"
+
+namespace gr {
+  namespace lora {
+
+    // Forward interleaver dimensions:
+    //  PPM   == number of bits per symbol OUT of interleaver        AND number of codewords IN to interleaver
+    //  RDD+4 == number of bits per codeword IN to interleaver       AND number of interleaved codewords OUT of interleaver
+    //
+    // bit width in:  (4+rdd)   block length: ppm
+    // bit width out: ppm       block length: (4+rdd)
+
+    // Interleaves every complete block of num_codewords codewords, as the encoder's Hamming table lays them out,
+    // into raw symbols.  Returns the number of symbols written.
+    //
+    // Exact inverse of deinterleave_codewords: codeword cw becomes column ppm-1-cw
+    // of a bit matrix whose transpose holds each symbol rotated left by its index.
+    inline size_t
+    interleave_codewords(const unsigned char *codewords,
+                         size_t num_codewords,
+                         unsigned char ppm,
+                         unsigned char rdd,
+                         unsigned short *symbols)
+    {
+      unsigned char reordered[INTERLEAVER_BLOCK_SIZE];
+      uint64_t      lo_rows, hi_rows;
+      size_t        num_symbols = 0;
+
+      for (size_t block_start = 0; block_start + ppm <= num_codewords; block_start += ppm)
+      {
+        const unsigned char *block_codewords = &codewords[block_start];
+        int cw_idx = 0;
+
+        // Undo the deinterleaver's output order: pairs from the top down, led by the top codeword alone if ppm is odd
+        if (ppm % 2)
+        {
+          reordered[ppm-1] = block_codewords[cw_idx++];
+        }
+        for (int pos = (ppm & ~0x1) - 2; pos >= 0; pos -= 2)
+        {
+          reordered[pos]   = block_codewords[cw_idx++];
+          reordered[pos+1] = block_codewords[cw_idx++];
+        }
+
+        lo_rows = 0;
+        hi_rows = 0;
+
+        for (cw_idx = 0; cw_idx < ppm; cw_idx++)
+        {
+          int column = ppm-1-cw_idx;
+          uint64_t row = reordered[cw_idx] & ((1 << (4+rdd)) - 1);
+
+          if (column < 8) lo_rows |= row << (8*column);
+          else            hi_rows |= row << (8*(column-8));
+        }
+
+        lo_rows = transpose_8x8(lo_rows);
+        hi_rows = transpose_8x8(hi_rows);
+
+        for (int s = 0; s < (4+rdd); s++)
+        {
+          unsigned short row    = ((lo_rows >> (8*s)) & 0xFF) | (((hi_rows >> (8*s)) & 0xFF) << 8);
+          unsigned short symbol = rotate_right(row, s, ppm);
+
+          // Swap MSBs of each symbol (one of LoRa's quirks)
+          symbols[num_symbols++] = ( (symbol &  (0x1 << (ppm-1))) >> 1 |
+                                     (symbol &  (0x1 << (ppm-2))) << 1 |
+                                     (symbol & ((0x1 << (ppm-2)) - 1)) );
+        }
+      }
+
+      return num_symbols;
+    }
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_INTERLEAVER_H */
@@ -23,51 +23,85 @@
 #endif
 
 #include <gnuradio/io_signature.h>
+#include <algorithm>
+#include <cstring>
 #include "mod_impl.h"
+#include "pdu_keys.h"
+#include "phy_header.h"
 
 #define DUMP_IQ 0 // Enables debug output
 
 namespace gr {
   namespace lora {
 
+    // Segments queued for the longest packet at this spreading factor: a 255-byte payload at code rate 4/8
+    // with a CRC, and low data rate optimization, which the modulator cannot see, stretching it further
+    static unsigned int
+    mod_max_segments(short spreading_factor)
+    {
+      return MOD_FRAME_SEGMENTS + phy_packet_symbols(spreading_factor, 255, 4, true, true);
+    }
+
     mod::sptr
-    mod::make(  short spreading_factor, unsigned char sync_word)
+    mod::make(  short spreading_factor, unsigned char sync_word, bool burst, unsigned short oversampling)
     {
       return gnuradio::get_initial_sptr
-        (new mod_impl(spreading_factor, sync_word));
+        (new mod_impl(spreading_factor, sync_word, burst, oversampling));
     }
 
     /*
      * The private constructor
      */
     mod_impl::mod_impl( short spreading_factor,
-                        unsigned char sync_word)
+                        unsigned char sync_word,
+                        bool burst,
+                        unsigned short oversampling)
       : gr::block("mod",
               gr::io_signature::make(0, 0, 0),
               gr::io_signature::make(1, 1, sizeof(gr_complex))),
         f_mod("mod.out", std::ios::out),
         d_sf(spreading_factor),
-        d_sync_word(sync_word)
+        d_sync_word(sync_word),
+        d_burst(burst),
+        d_oversampling(oversampling),
+        d_queue(MOD_QUEUE_LONGEST*mod_max_segments(spreading_factor), MOD_QUEUE_PACKETS)
     {
       assert((d_sf > 5) && (d_sf < 13));
+      assert(d_oversampling > 0);
 
       d_in_port = pmt::mp("in");
       message_port_register_in(d_in_port);
       set_msg_handler(d_in_port, boost::bind(&mod_impl::modulate, this, _1));
 
-      d_fft_size = (1 << d_sf);
+      d_fft_size  = (1 << d_sf);
+      d_chirp_len = d_fft_size*d_oversampling;
 
-      float phase = -M_PI;
-      double accumulator = 0;
+      // An upchirp sweeps from -1/2 to +1/2 cycles per chip over d_fft_size chips; per output sample that is
+      // -1/(2*OS) to +1/(2*OS) cycles, in d_chirp_len steps.  The ramp is centred on each group of OS samples
+      // leading up to a chip boundary, and wraps between groups, so every OS-th sample lands on the 1x chirp.
+      // Words are computed in 64 bits, so the ramp does not drift at any oversampling ratio.
+      for (int i = 0; i < 2*d_chirp_len; i++)
+      {
+        int64_t  step = 2*((i + d_oversampling - 1) % d_chirp_len) - (d_oversampling - 1);   // In half samples
+        uint32_t freq = (uint32_t)((step*((int64_t)1 << 32)) / (2*(int64_t)d_chirp_len*d_oversampling) - ((int64_t)1 << 31)/d_oversampling);
 
-      for (int i = 0; i < 2*d_fft_size; i++)
+        d_upchirp_freq.push_back(freq);
+        d_downchirp_freq.push_back(-freq);
+      }
+
+      for (int i = 0; i < (1 << NCO_LUT_BITS); i++)
       {
-        accumulator += phase;
-        d_downchirp.push_back(gr_complex(std::conj(std::polar(1.0, accumulator))));
-        d_upchirp.push_back(gr_complex(std::polar(1.0, accumulator)));
-        phase += (2*M_PI)/d_fft_size;
+        d_nco_lut.push_back(std::polar(1.0f, (float)(2*M_PI*i/(1 << NCO_LUT_BITS))));
       }
 
+      d_phase = 0;
+
+      d_segment.type   = CHIRP_ZERO;
+      d_segment.offset = 0;
+      d_segment.length = 0;
+      d_segment_pos    = 0;
+      d_segments_left  = 0;
+      d_packet_end     = 0;
     }
 
     /*
@@ -77,65 +111,110 @@ namespace gr {
     {
     }
 
+    void
+    mod_impl::push_segment(chirp_type_t type,
+                           unsigned short offset,
+                           unsigned int length)
+    {
+      chirp_segment segment;
+
+      // Offsets and lengths are given in chips
+      segment.type   = type;
+      segment.offset = (offset % d_fft_size)*d_oversampling;
+      segment.length = length*d_oversampling;
+
+      d_queue.push(segment);
+    }
+
     void
     mod_impl::modulate (pmt::pmt_t msg)
     {
+      pmt::pmt_t meta(pmt::car(msg));
       pmt::pmt_t symbols(pmt::cdr(msg));
 
       size_t pkt_len(0);
       const uint16_t* symbols_in = pmt::u16vector_elements(symbols, pkt_len);
 
-      std::vector<gr_complex> iq_out;
+      mod_packet packet;
 
-      // Preamble
-      for (int i = 0; i < NUM_PREAMBLE_CHIRPS*d_fft_size; i++)
-      {
-        iq_out.push_back(d_upchirp[(i) % d_fft_size]);
-      }
+      // Preamble, 2 sync words, 3 SFD segments and payload, plus a silent lead-in and tail unless sent as a burst
+      packet.num_segments = NUM_PREAMBLE_CHIRPS + 2 + 3 + pkt_len + (d_burst ? 0 : 2);
+      packet.num_samples  = ((NUM_PREAMBLE_CHIRPS + 2 + 2 + pkt_len)*d_fft_size + d_fft_size/4 +
+                             (d_burst ? 0 : (MOD_LEAD_CHIRPS + MOD_TAIL_CHIRPS)*d_fft_size + MOD_TAIL_SAMPLES))*d_oversampling;
+      packet.tx_time      = (d_burst && pmt::is_dict(meta)) ? pmt::dict_ref(meta, TAG_TX_TIME, pmt::PMT_NIL) : pmt::PMT_NIL;
 
-      // Sync Word 0
-      for (int i = 0; i < d_fft_size; i++)
+      // The handler shares a thread with general_work, so it cannot wait for room; drop whole packets instead of blocking
+      if (!d_queue.begin(packet))
       {
-        iq_out.push_back(d_upchirp[(8*((d_sync_word & 0xF0) >> 4) + i) % d_fft_size]);
+        std::cerr << "lora::mod: packet queue full, dropping packet " << packet.sequence << " (" << d_queue.dropped() << " dropped)" << std::endl;
+        return;
       }
 
-      // Sync Word 1
-      for (int i = 0; i < d_fft_size; i++)
+      // Prepend zero-magnitude samples
+      if (!d_burst) push_segment(CHIRP_ZERO, 0, MOD_LEAD_CHIRPS*d_fft_size);
+
+      // Preamble
+      for (int i = 0; i < NUM_PREAMBLE_CHIRPS; i++)
       {
-        iq_out.push_back(d_upchirp[(8*(d_sync_word & 0x0F) + i) % d_fft_size]);
+        push_segment(CHIRP_UP, 0, d_fft_size);
       }
 
+      // Sync Words
+      push_segment(CHIRP_UP, 8*((d_sync_word & 0xF0) >> 4), d_fft_size);
+      push_segment(CHIRP_UP, 8*(d_sync_word & 0x0F),        d_fft_size);
+
       // SFD Downchirps
-      for (int i = 0; i < (2*d_fft_size+d_fft_size/4); i++)
-      {
-        iq_out.push_back(d_downchirp[(i) % d_fft_size]);
-      }
+      push_segment(CHIRP_DOWN, 0, d_fft_size);
+      push_segment(CHIRP_DOWN, 0, d_fft_size);
+      push_segment(CHIRP_DOWN, 0, d_fft_size/4);
 
       // Payload
       for (int i = 0; i < pkt_len; i++)
       {
-        for (int j = 0; j < d_fft_size; j++)
-        {
-          iq_out.push_back(d_upchirp[(symbols_in[i] + (d_fft_size/4) + j) % d_fft_size]); // MAGIC -- adjusting for the SFD quarter chirp
-        }
+        push_segment(CHIRP_UP, symbols_in[i] + (d_fft_size/4), d_fft_size);   // MAGIC -- adjusting for the SFD quarter chirp
       }
 
-      // Prepend zero-magnitude samples
-      d_iq_out.insert(d_iq_out.begin(), 4*d_fft_size, gr_complex(std::polar(0.0, 0.0)));
+      // Append zero-magnitude samples to kick squelch in simulation
+      if (!d_burst) push_segment(CHIRP_ZERO, 0, MOD_TAIL_CHIRPS*d_fft_size + MOD_TAIL_SAMPLES);
+
+      // Publish the packet only now that all of its segments are queued
+      d_queue.publish(packet);
+
+      gr::thread::scoped_lock lock(d_packet_mutex);
+      d_packet_cond.notify_one();
+    }
 
-      // Append samples to IQ output buffer
-      for (int i = 0; i < iq_out.size(); i++)
+    // Advances d_segment to the next segment to render, starting the next queued packet when the current one is done
+    // offset is the absolute output index the segment will start at; returns false when no packet is waiting
+    bool
+    mod_impl::next_segment(uint64_t offset)
+    {
+      if (d_segments_left == 0)
       {
-        d_iq_out.push_back(iq_out[i]);  // Writing to buffer separately for now to expose local packet for debugging
+        mod_packet    packet;
+        unsigned long missed;
+        if (!d_queue.pop_packet(packet, missed)) return false;
+
+        if (missed)
+        {
+          std::cerr << "lora::mod: packets " << packet.sequence - missed << " to " << packet.sequence - 1 << " were not sent" << std::endl;
+        }
+
+        d_segments_left = packet.num_segments;
+        d_packet_end    = offset + packet.num_samples;
+
+        if (d_burst)
+        {
+          add_item_tag(0, offset, TAG_TX_SOB, pmt::PMT_T);
+          if (!pmt::is_null(packet.tx_time)) add_item_tag(0, offset, TAG_TX_TIME, packet.tx_time);
+        }
       }
-      
-      // Append zero-magnitude samples to kick squelch in simulation
-      d_iq_out.insert(d_iq_out.end(), 4*d_fft_size+128, gr_complex(std::polar(0.0, 0.0)));
 
-      // Uncomment to write out modulated payload to disk
-      #if DUMP_IQ
-        f_mod.write((const char *)&d_iq_out[0], d_iq_out.size()*sizeof(gr_complex));
-      #endif
+      d_queue.pop_segment(d_segment);
+      d_segments_left--;
+      d_segment_pos = 0;
+
+      return true;
     }
 
     int
@@ -145,14 +224,65 @@ namespace gr {
                        gr_vector_void_star &output_items)
     {
       gr_complex *out = (gr_complex *) output_items[0];
-      unsigned int noutput_samples = (noutput_items > d_iq_out.size()) ? d_iq_out.size() : noutput_items;
+      int noutput_samples = 0;
+
+      // Nothing queued: sleep instead of spinning through zero-length calls, but return as soon as a message is
+      // pending, since the scheduler delivers it to modulate() on this same thread once general_work returns
+      if (d_segment_pos == d_segment.length && d_segments_left == 0 && d_queue.empty())
+      {
+        gr::thread::scoped_lock lock(d_packet_mutex);
+        while (d_queue.empty() && empty_handled_p())
+        {
+          d_packet_cond.timed_wait(lock, boost::posix_time::milliseconds(MOD_IDLE_POLL_MS));
+        }
+      }
 
-      if (noutput_samples)
+      // Run the chirp engine over each segment; the frequency tables are two chirps long, so any offset is one contiguous run
+      while (noutput_samples < noutput_items)
       {
-        memcpy(out, &d_iq_out[0], noutput_samples*sizeof(gr_complex));
-        d_iq_out.erase(d_iq_out.begin(), d_iq_out.begin()+noutput_samples);
+        if (d_segment_pos == d_segment.length)
+        {
+          if (!next_segment(nitems_written(0) + noutput_samples)) break;
+        }
+
+        unsigned int num_samples = std::min((unsigned int)(noutput_items - noutput_samples), d_segment.length - d_segment_pos);
+
+        if (d_segment.type == CHIRP_ZERO)
+        {
+          memset(&out[noutput_samples], 0, num_samples*sizeof(gr_complex));
+        }
+        else
+        {
+          const uint32_t *freq  = (d_segment.type == CHIRP_UP) ? &d_upchirp_freq[d_segment.offset + d_segment_pos]
+                                                               : &d_downchirp_freq[d_segment.offset + d_segment_pos];
+          gr_complex     *chirp = &out[noutput_samples];
+          uint32_t        phase = d_phase;
+
+          // Round to the nearest table entry
+          for (unsigned int i = 0; i < num_samples; i++)
+          {
+            phase   += freq[i];
+            chirp[i] = d_nco_lut[(phase + (1u << (NCO_LUT_SHIFT - 1))) >> NCO_LUT_SHIFT];
+          }
+
+          d_phase = phase;
+        }
+
+        d_segment_pos   += num_samples;
+        noutput_samples += num_samples;
+
+        // The last sample of a burst carries the end tag
+        if (d_burst && d_segments_left == 0 && d_segment_pos == d_segment.length)
+        {
+          add_item_tag(0, d_packet_end - 1, TAG_TX_EOB, pmt::PMT_T);
+        }
       }
 
+      // Uncomment to write out modulated payload to disk
+      #if DUMP_IQ
+        f_mod.write((const char *)out, noutput_samples*sizeof(gr_complex));
+      #endif
+
       return noutput_samples;
     }
 
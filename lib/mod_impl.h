@@ -21,16 +21,31 @@
 #ifndef INCLUDED_LORA_MOD_IMPL_H
 #define INCLUDED_LORA_MOD_IMPL_H
 
+#include <iostream>
 #include <vector>
 #include <complex>
 #include <fstream>
 #include <volk/volk.h>
+#include <gnuradio/thread/thread.h>
 #include <lora/mod.h>
+#include "mod_queue.h"
 
 #define NUM_PREAMBLE_CHIRPS   8
 #define LORA_SYNCWORD0        3
 #define LORA_SYNCWORD1        4
 
+#define MOD_QUEUE_LONGEST     6     // Chirp segment queue capacity, in packets of the longest possible length
+#define MOD_FRAME_SEGMENTS    (NUM_PREAMBLE_CHIRPS + 2 + 3 + 2)   // Preamble, 2 sync words, 3 SFD segments, lead-in and tail
+#define MOD_LEAD_CHIRPS       4     // Zero-magnitude chirps sent ahead of each packet
+#define MOD_TAIL_CHIRPS       4     // Zero-magnitude chirps (plus MOD_TAIL_SAMPLES) sent after each packet to kick squelch in simulation
+#define MOD_TAIL_SAMPLES      128
+
+#define MOD_QUEUE_PACKETS     64    // Packet descriptor queue capacity
+#define MOD_IDLE_POLL_MS      1     // While idle, general_work sleeps this long between checks for pending messages
+
+#define NCO_LUT_BITS          12    // Phase resolution of the sine/cosine table, in bits of the 32-bit phase accumulator
+#define NCO_LUT_SHIFT         (32 - NCO_LUT_BITS)
+
 namespace gr {
   namespace lora {
 
@@ -41,22 +56,40 @@ namespace gr {
 
       unsigned char d_sf;
       unsigned char d_sync_word;
+      bool          d_burst;        // Tag each packet as a tx_sob/tx_eob burst instead of padding it with silence
 
       unsigned short d_fft_size;
       unsigned char  d_interleaver_size;
-
-      std::vector<gr_complex> d_upchirp;
-      std::vector<gr_complex> d_downchirp;
-
-      std::vector<gr_complex> d_iq_out;
+      unsigned short d_oversampling;   // Output samples per chip
+      unsigned int   d_chirp_len;      // Output samples per chirp, d_fft_size*d_oversampling
+
+      // Chirp engine: a 32-bit phase accumulator (2**32 == one cycle) advanced by a per-sample frequency word
+      // Each table holds the frequency words of one chirp, twice, so a chirp starting at any offset reads one contiguous run
+      std::vector<uint32_t>   d_upchirp_freq;
+      std::vector<uint32_t>   d_downchirp_freq;
+      std::vector<gr_complex> d_nco_lut;      // exp(j*2*pi*k/2**NCO_LUT_BITS)
+      uint32_t                d_phase;        // Carried across segments, so consecutive chirps are phase continuous
+
+      // Packets waiting to be sent, as chirp segments queued by the message handler and rendered by general_work
+      mod_queue               d_queue;
+      chirp_segment           d_segment;          // Segment being rendered
+      unsigned int            d_segment_pos;      // Samples of d_segment already rendered
+      unsigned int            d_segments_left;    // Segments of the current packet not yet taken from d_queue
+      uint64_t                d_packet_end;       // Absolute output index just past the packet being rendered
+
+      // Wakes an idle work thread when a packet is queued from another thread
+      gr::thread::mutex              d_packet_mutex;
+      gr::thread::condition_variable d_packet_cond;
 
       std::ofstream f_mod;
 
      public:
-      mod_impl( short spreading_factor, unsigned char d_sync_word);
+      mod_impl( short spreading_factor, unsigned char d_sync_word, bool burst, unsigned short oversampling);
       ~mod_impl();
 
       void modulate (pmt::pmt_t msg);
+      void push_segment(chirp_type_t type, unsigned short offset, unsigned int length);
+      bool next_segment(uint64_t offset);
 
       int general_work(int noutput_items,
            gr_vector_int &ninput_items,
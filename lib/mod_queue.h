@@ -0,0 +1,152 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_MOD_QUEUE_H
+#define INCLUDED_LORA_MOD_QUEUE_H
+
+#include <stddef.h>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <pmt/pmt.h>
+
+namespace gr {
+  namespace lora {
+
+    enum chirp_type_t
+    {
+      CHIRP_UP,
+      CHIRP_DOWN,
+      CHIRP_ZERO
+    };
+
+    // A run of output samples, synthesized only when general_work reaches it
+    struct chirp_segment
+    {
+      chirp_type_t    type;
+      unsigned int    offset;   // Starting output sample within the chirp's frequency ramp
+      unsigned int    length;   // Output samples; at most one chirp for CHIRP_UP and CHIRP_DOWN
+    };
+
+    // A packet whose segments are all queued; the work thread takes nothing from a packet until its descriptor is published
+    struct mod_packet
+    {
+      unsigned long   sequence;       // Counts every packet handed to the modulator, so gaps mark dropped packets
+      unsigned int    num_segments;
+      unsigned long   num_samples;
+      pmt::pmt_t      tx_time;        // Transmit time from the PDU metadata in burst mode, or PMT_NIL
+    };
+
+    /*
+     * Packets waiting to be sent, as chirp segments queued by one producer
+     * thread and taken by one consumer thread.  Both queues are fixed-size
+     * rings, sized at construction.
+     *
+     * The producer numbers a packet with begin(), pushes its segments, then
+     * publishes its descriptor with publish(); the consumer only ever sees
+     * whole packets.  A packet that does not fit is refused by begin() whole,
+     * and the consumer sees its number missing from the sequence.
+     */
+    class mod_queue
+    {
+     private:
+      boost::lockfree::spsc_queue<chirp_segment> d_segments;
+      boost::lockfree::spsc_queue<mod_packet>    d_packets;
+
+      unsigned long d_sequence;       // Producer: sequence number for the next packet
+      unsigned long d_dropped;        // Producer: packets refused for lack of room
+      unsigned long d_sent_sequence;  // Consumer: sequence number of the last packet taken, 0 before the first
+
+     public:
+      mod_queue(size_t max_segments, size_t max_packets)
+        : d_segments(max_segments),
+          d_packets(max_packets),
+          d_sequence(1),
+          d_dropped(0),
+          d_sent_sequence(0)
+      {
+      }
+
+      // Producer: numbers packet and checks there is room for its num_segments segments and its descriptor
+      // Returns false, counting the packet as dropped, when there is not; nothing of it may then be pushed
+      bool
+      begin(mod_packet &packet)
+      {
+        packet.sequence = d_sequence++;
+
+        if (packet.num_segments > d_segments.write_available() || !d_packets.write_available())
+        {
+          d_dropped++;
+          return false;
+        }
+
+        return true;
+      }
+
+      // Producer: queues one segment of the packet passed to the last successful begin()
+      void
+      push(const chirp_segment &segment)
+      {
+        d_segments.push(segment);
+      }
+
+      // Producer: makes the packet visible to the consumer, once all of its segments are pushed
+      void
+      publish(const mod_packet &packet)
+      {
+        d_packets.push(packet);
+      }
+
+      // Consumer: takes the next whole packet's descriptor, if any
+      // missed is the number of packets dropped since the last one taken, which were numbered just before this one
+      bool
+      pop_packet(mod_packet &packet, unsigned long &missed)
+      {
+        if (!d_packets.pop(packet)) return false;
+
+        missed          = packet.sequence - d_sent_sequence - 1;
+        d_sent_sequence = packet.sequence;
+
+        return true;
+      }
+
+      // Consumer: takes the next segment of the packet last taken by pop_packet()
+      bool
+      pop_segment(chirp_segment &segment)
+      {
+        return d_segments.pop(segment);
+      }
+
+      // Consumer: true when no published packet is waiting
+      bool
+      empty()
+      {
+        return d_packets.empty();
+      }
+
+      unsigned long
+      dropped() const
+      {
+        return d_dropped;
+      }
+    };
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_MOD_QUEUE_H */
@@ -0,0 +1,97 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 Bastille Networks.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "multi_sf_demod_impl.h"
+
+namespace gr {
+  namespace lora {
+
+    multi_sf_demod::sptr
+    multi_sf_demod::make( unsigned short min_sf,
+                          unsigned short max_sf,
+                          bool  low_data_rate,
+                          float beta,
+                          unsigned short fft_factor,
+                          bool  batch_sync,
+                          unsigned short oversampling,
+                          bool  soft_decoding,
+                          bool  header,
+                          bool  stream)
+    {
+      return gnuradio::get_initial_sptr
+        (new multi_sf_demod_impl(min_sf, max_sf, low_data_rate, beta, fft_factor, batch_sync, oversampling, soft_decoding, header, stream));
+    }
+
+    /*
+     * The private constructor
+     */
+    multi_sf_demod_impl::multi_sf_demod_impl( unsigned short min_sf,
+                                              unsigned short max_sf,
+                                              bool  low_data_rate,
+                                              float beta,
+                                              unsigned short fft_factor,
+                                              bool  batch_sync,
+                                              unsigned short oversampling,
+                                              bool  soft_decoding,
+                                              bool  header,
+                                              bool  stream)
+      : gr::hier_block2("multi_sf_demod",
+              gr::io_signature::make(1, 1, sizeof(gr_complex)),
+              gr::io_signature::make(0, 0, 0))
+    {
+      assert((min_sf > 5) && (max_sf < 13));
+      assert(min_sf <= max_sf);
+      if (min_sf == 6) assert(!header);
+
+      d_out_port = pmt::mp("out");
+      message_port_register_hier_out(d_out_port);
+
+      // Stream PDUs carry the same "sf" entry, so a streaming decoder per SF can share this port too
+      d_stream_port = pmt::mp("stream");
+      message_port_register_hier_out(d_stream_port);
+
+      // Every demodulator reads the same input buffer; the scheduler runs each in its own thread
+      for (unsigned short sf = min_sf; sf <= max_sf; sf++)
+      {
+        demod::sptr demod_sf = demod::make(sf, low_data_rate, beta, fft_factor, batch_sync, oversampling, soft_decoding, header, stream);
+
+        connect(self(), 0, demod_sf, 0);
+        msg_connect(demod_sf, d_out_port,    self(), d_out_port);
+        msg_connect(demod_sf, d_stream_port, self(), d_stream_port);
+
+        d_demods.push_back(demod_sf);
+      }
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    multi_sf_demod_impl::~multi_sf_demod_impl()
+    {
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
+
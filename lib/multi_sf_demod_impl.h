@@ -0,0 +1,57 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 Bastille Networks.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_MULTI_SF_DEMOD_IMPL_H
+#define INCLUDED_LORA_MULTI_SF_DEMOD_IMPL_H
+
+#include <vector>
+#include <lora/multi_sf_demod.h>
+#include <lora/demod.h>
+
+namespace gr {
+  namespace lora {
+
+    class multi_sf_demod_impl : public multi_sf_demod
+    {
+     private:
+      pmt::pmt_t d_out_port;
+      pmt::pmt_t d_stream_port;
+
+      std::vector<demod::sptr> d_demods;
+
+     public:
+      multi_sf_demod_impl(unsigned short min_sf,
+                          unsigned short max_sf,
+                          bool  low_data_rate,
+                          float beta,
+                          unsigned short fft_factor,
+                          bool  batch_sync,
+                          unsigned short oversampling,
+                          bool  soft_decoding,
+                          bool  header,
+                          bool  stream);
+      ~multi_sf_demod_impl();
+    };
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_MULTI_SF_DEMOD_IMPL_H */
+
@@ -0,0 +1,63 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_PDU_KEYS_H
+#define INCLUDED_LORA_PDU_KEYS_H
+
+#include <pmt/pmt.h>
+
+namespace gr {
+  namespace lora {
+
+    /*
+     * PDU metadata keys passed between the demodulator and decoder, and stream tag keys.
+     *
+     * Interning a symbol hashes its name and takes the symbol table lock, so the
+     * per-symbol and per-packet paths use these instead of calling pmt::mp() each time.
+     */
+    static const pmt::pmt_t PDU_KEY_SF              = pmt::mp("sf");
+    static const pmt::pmt_t PDU_KEY_PACKET          = pmt::mp("packet");
+    static const pmt::pmt_t PDU_KEY_INDEX           = pmt::mp("index");
+    static const pmt::pmt_t PDU_KEY_END             = pmt::mp("end");
+    static const pmt::pmt_t PDU_KEY_OFFSET          = pmt::mp("offset");
+    static const pmt::pmt_t PDU_KEY_LENGTH          = pmt::mp("length");
+    static const pmt::pmt_t PDU_KEY_CRC_VALID       = pmt::mp("crc_valid");
+    static const pmt::pmt_t PDU_KEY_CHANNEL         = pmt::mp("channel");
+
+    // Synchronization estimates
+    static const pmt::pmt_t PDU_KEY_CFO             = pmt::mp("cfo");
+    static const pmt::pmt_t PDU_KEY_CFO_DRIFT       = pmt::mp("cfo_drift");
+    static const pmt::pmt_t PDU_KEY_STO             = pmt::mp("sto");
+
+    // Soft decisions
+    static const pmt::pmt_t PDU_KEY_SOFT_CANDIDATES = pmt::mp("soft_candidates");
+    static const pmt::pmt_t PDU_KEY_SOFT_SYMBOLS    = pmt::mp("soft_symbols");
+    static const pmt::pmt_t PDU_KEY_SOFT_MAGNITUDES = pmt::mp("soft_magnitudes");
+    static const pmt::pmt_t PDU_KEY_SOFT_NOISE      = pmt::mp("soft_noise");
+
+    // Burst stream tags understood by USRP sinks; "tx_time" is also read from the modulator's PDU metadata
+    static const pmt::pmt_t TAG_TX_SOB              = pmt::mp("tx_sob");
+    static const pmt::pmt_t TAG_TX_EOB              = pmt::mp("tx_eob");
+    static const pmt::pmt_t TAG_TX_TIME             = pmt::mp("tx_time");
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_PDU_KEYS_H */
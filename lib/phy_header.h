@@ -0,0 +1,120 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_PHY_HEADER_H
+#define INCLUDED_LORA_PHY_HEADER_H
+
+#include <stddef.h>
+#include "deinterleaver.h"
+
+/*
+ * Explicit PHY header, carried in the first nybbles of the 8-symbol header block:
+ *  [0] payload length, high nybble
+ *  [1] payload length, low nybble
+ *  [2] code rate << 1 | CRC present
+ *  [3] checksum bit 4
+ *  [4] checksum bits 3:0
+ */
+#define PHY_HEADER_NYBBLES   5
+#define PHY_HEADER_SYMBOLS   8    // The header block is always 8 symbols at ppm=sf-2, rdd=4
+#define PHY_CRC_NYBBLES      4    // A 16-bit payload CRC follows the payload when present
+#define PHY_MAX_CR           4    // Code rates 4/5 to 4/8
+
+namespace gr {
+  namespace lora {
+
+    // 5-bit checksum over the first three header nybbles
+    inline unsigned char
+    phy_header_checksum(const unsigned char *nybbles)
+    {
+      unsigned char a = nybbles[0], b = nybbles[1], c = nybbles[2];
+
+      unsigned char c4 = (a >> 3 & 1) ^ (a >> 2 & 1) ^ (a >> 1 & 1) ^ (a & 1);
+      unsigned char c3 = (a >> 3 & 1) ^ (b >> 3 & 1) ^ (b >> 2 & 1) ^ (b >> 1 & 1) ^ (c & 1);
+      unsigned char c2 = (a >> 2 & 1) ^ (b >> 3 & 1) ^ (b & 1)      ^ (c >> 3 & 1) ^ (c >> 1 & 1);
+      unsigned char c1 = (a >> 1 & 1) ^ (b >> 2 & 1) ^ (b & 1)      ^ (c >> 2 & 1) ^ (c >> 1 & 1) ^ (c & 1);
+      unsigned char c0 = (a & 1)      ^ (b >> 1 & 1) ^ (c >> 3 & 1) ^ (c >> 2 & 1) ^ (c >> 1 & 1) ^ (c & 1);
+
+      return (c4 << 4) | (c3 << 3) | (c2 << 2) | (c1 << 1) | c0;
+    }
+
+    // Checks and unpacks an explicit header from the first PHY_HEADER_NYBBLES decoded nybbles
+    inline bool
+    phy_header_parse(const unsigned char *nybbles,
+                     size_t num_nybbles,
+                     unsigned char &payload_len,
+                     unsigned char &cr,
+                     bool &crc)
+    {
+      if (num_nybbles < PHY_HEADER_NYBBLES) return false;
+
+      unsigned char checksum = ((nybbles[3] & 0x1) << 4) | (nybbles[4] & 0x0F);
+      if (checksum != phy_header_checksum(nybbles)) return false;
+
+      payload_len = (nybbles[0] << 4) | nybbles[1];
+      cr          = nybbles[2] >> 1;
+      crc         = nybbles[2] & 0x1;
+
+      return (cr > 0) && (cr <= PHY_MAX_CR);
+    }
+
+    // Decodes an explicit header straight from the PHY_HEADER_SYMBOLS demodulated symbols of the
+    // header block, already reduced to ppm=sf-2 bits.  The header is not whitened, so this is
+    // gray mapping, one deinterleaver block and rdd 4 Hamming decoding with hamming_table.
+    inline bool
+    phy_header_decode(const unsigned short *symbols,
+                      unsigned char sf,
+                      const unsigned char *hamming_table,
+                      unsigned char &payload_len,
+                      unsigned char &cr,
+                      bool &crc)
+    {
+      unsigned short gray[PHY_HEADER_SYMBOLS];
+      unsigned char  codewords[INTERLEAVER_BLOCK_SIZE];
+
+      for (int i = 0; i < PHY_HEADER_SYMBOLS; i++)
+      {
+        gray[i] = (symbols[i] >> 1) ^ symbols[i];
+      }
+
+      size_t num_nybbles = deinterleave_codewords(gray, PHY_HEADER_SYMBOLS, sf-2, 4, codewords);
+      for (size_t i = 0; i < num_nybbles; i++)
+      {
+        codewords[i] = hamming_table[codewords[i]] & 0x0F;
+      }
+
+      return phy_header_parse(codewords, num_nybbles, payload_len, cr, crc);
+    }
+
+    // Total number of symbols in an explicit header packet, header block included
+    inline unsigned int
+    phy_packet_symbols(unsigned char sf, unsigned char payload_len, unsigned char cr, bool crc, bool ldr)
+    {
+      int num_bits     = 8*payload_len - 4*sf + 28 + (crc ? 16 : 0);
+      int bits_per_blk = 4*(sf - (ldr ? 2 : 0));
+      int num_blocks   = (num_bits > 0) ? (num_bits + bits_per_blk - 1) / bits_per_blk : 0;
+
+      return PHY_HEADER_SYMBOLS + num_blocks*(4 + cr);
+    }
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_PHY_HEADER_H */
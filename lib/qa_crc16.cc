@@ -0,0 +1,127 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cstdlib>
+#include <cstring>
+#include "qa_crc16.h"
+#include "qa_flowgraph.h"
+#include "crc16.h"
+#include "pdu_keys.h"
+
+#define QA_CRC_PAYLOAD_LEN 10
+
+namespace gr {
+  namespace lora {
+
+    // Decodes symbols with a fresh decoder and checks that the frame comes back as payload, or is dropped
+    // on its CRC and counted when corrupt is set
+    static void
+    check_frame(decode::sptr dec,
+                const std::vector<uint16_t> &symbols,
+                const std::vector<uint8_t> &payload,
+                bool corrupt)
+    {
+      gr::blocks::message_debug::sptr dbg = qa_decode(dec, pmt::make_dict(), symbols);
+
+      if (corrupt)
+      {
+        CPPUNIT_ASSERT_EQUAL(0, dbg->num_messages());
+        CPPUNIT_ASSERT_EQUAL(0ul, dec->crc_pass_count());
+        CPPUNIT_ASSERT_EQUAL(1ul, dec->crc_fail_count());
+        return;
+      }
+
+      CPPUNIT_ASSERT_EQUAL(1, dbg->num_messages());
+      CPPUNIT_ASSERT_EQUAL(1ul, dec->crc_pass_count());
+      CPPUNIT_ASSERT_EQUAL(0ul, dec->crc_fail_count());
+
+      pmt::pmt_t frame = dbg->get_message(0);
+      size_t num_bytes(0);
+      const uint8_t *bytes = pmt::u8vector_elements(pmt::cdr(frame), num_bytes);
+
+      CPPUNIT_ASSERT_EQUAL(payload.size(), num_bytes);
+      CPPUNIT_ASSERT(std::equal(payload.begin(), payload.end(), bytes));
+      CPPUNIT_ASSERT(pmt::to_bool(pmt::dict_ref(pmt::car(frame), PDU_KEY_CRC_VALID, pmt::PMT_F)));
+    }
+
+    // Flips bit 0 of the first payload symbol.  Gray decoding, de-whitening and the MSB swap all leave
+    // bit 0 in place, and the deinterleaver makes it the data LSB of one payload codeword, which code
+    // rate 4/5 cannot correct, so exactly one payload or CRC bit arrives flipped.
+    static std::vector<uint16_t>
+    corrupt_symbols(std::vector<uint16_t> symbols)
+    {
+      symbols[PHY_HEADER_SYMBOLS] ^= 0x1;
+      return symbols;
+    }
+
+    void
+    qa_crc16::t1_check_value()
+    {
+      const char    *check = "123456789";
+      unsigned short table[256];
+      unsigned short crc = CRC16_INITIAL;
+
+      crc16_build_table(table);
+      for (size_t i = 0; i < strlen(check); i++) crc = crc16_update(table, crc, check[i]);
+
+      // CRC-16/XMODEM: polynomial 0x1021, initial value 0, no reflection or final XOR
+      CPPUNIT_ASSERT_EQUAL(0x31C3, (int)crc);
+    }
+
+    void
+    qa_crc16::t2_explicit_header()
+    {
+      std::vector<uint8_t> payload(QA_CRC_PAYLOAD_LEN);
+
+      srand(0);
+      for (short sf = 7; sf <= 12; sf++)
+      {
+        for (size_t i = 0; i < payload.size(); i++) payload[i] = rand() & 0xFF;
+
+        std::vector<uint16_t> symbols = qa_encode(sf, 1, false, true, true, payload);
+        CPPUNIT_ASSERT(symbols.size() > PHY_HEADER_SYMBOLS);
+
+        check_frame(decode::make(sf, 1, false, true, true), symbols, payload, false);
+        check_frame(decode::make(sf, 1, false, true, true), corrupt_symbols(symbols), payload, true);
+      }
+    }
+
+    void
+    qa_crc16::t3_implicit_length()
+    {
+      std::vector<uint8_t> payload(QA_CRC_PAYLOAD_LEN);
+
+      srand(1);
+      for (short sf = 7; sf <= 12; sf++)
+      {
+        for (size_t i = 0; i < payload.size(); i++) payload[i] = rand() & 0xFF;
+
+        std::vector<uint16_t> symbols = qa_encode(sf, 1, false, false, true, payload);
+        CPPUNIT_ASSERT(symbols.size() > PHY_HEADER_SYMBOLS);
+
+        // The configured length places the CRC; zero padding past it must not be taken for payload
+        check_frame(decode::make(sf, 1, false, false, true, QA_CRC_PAYLOAD_LEN), symbols, payload, false);
+        check_frame(decode::make(sf, 1, false, false, true, QA_CRC_PAYLOAD_LEN), corrupt_symbols(symbols), payload, true);
+      }
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
@@ -0,0 +1,82 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/fft/window.h>
+#include <cppunit/TestAssert.h>
+#include <volk/volk.h>
+#include <vector>
+#include <cstdlib>
+#include "qa_dechirp.h"
+#include "dechirp.h"
+
+#define DECHIRP_OFFSETS 16      // OVERLAP_FACTOR in demod_impl.cc
+#define WINDOW_BETA     25.0    // Default demod FFT window beta
+
+namespace gr {
+  namespace lora {
+
+    typedef std::complex<float> sample_t;
+
+    static void
+    random_samples(std::vector<sample_t> &samples)
+    {
+      for (size_t i = 0; i < samples.size(); i++)
+      {
+        samples[i] = sample_t(rand()/(float)RAND_MAX - 0.5f, rand()/(float)RAND_MAX - 0.5f);
+      }
+    }
+
+    void
+    qa_dechirp::t1_fused_equivalence()
+    {
+      srand(0);
+      for (int sf = 6; sf <= 12; sf++)
+      {
+        unsigned int n = 1 << sf;
+        std::vector<sample_t> upchirp, downchirp;
+        std::vector<float>    window = fft::window::build(fft::window::WIN_KAISER, n, WINDOW_BETA);
+        std::vector<sample_t> tables(DECHIRP_OFFSETS*n);
+        std::vector<sample_t> in(n), dechirped(n), expected(n), actual(n);
+
+        build_chirps(n, upchirp, downchirp);
+        build_windowed_downchirps(&downchirp[0], &window[0], n, DECHIRP_OFFSETS, &tables[0]);
+
+        for (unsigned int ol = 0; ol < DECHIRP_OFFSETS; ol++)
+        {
+          random_samples(in);
+
+          // Two passes, as the demodulator used to dechirp: downchirp at the offset, then the window
+          volk_32fc_x2_multiply_32fc(&dechirped[0], &in[0], &downchirp[(ol*n)/DECHIRP_OFFSETS], n);
+          volk_32fc_32f_multiply_32fc(&expected[0], &dechirped[0], &window[0], n);
+
+          volk_32fc_x2_multiply_32fc(&actual[0], &in[0], &tables[ol*n], n);
+
+          for (unsigned int i = 0; i < n; i++)
+          {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i].real(), actual[i].real(), 1e-6);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i].imag(), actual[i].imag(), 1e-6);
+          }
+        }
+      }
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
@@ -0,0 +1,193 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <vector>
+#include <cstdlib>
+#include "qa_deinterleaver.h"
+#include "deinterleaver.h"
+#include "interleaver.h"
+#include "hamming.h"
+#include "reference_kernels.h"
+
+#define TEST_BLOCKS 4096
+
+namespace gr {
+  namespace lora {
+
+    // The whole pre-transpose deinterleaver, whose fixed output order only covered ppm <= 8
+    static void
+    reference_deinterleave(std::vector<unsigned short> symbols,
+                           std::vector<unsigned char> &codewords,
+                           unsigned char ppm,
+                           unsigned char rdd)
+    {
+      unsigned char block[INTERLEAVER_BLOCK_SIZE];
+
+      for (size_t i = 0; i < symbols.size(); i++)
+      {
+        symbols[i] = ( (symbols[i] &  (0x1 << (ppm-1))) >> 1 |
+                       (symbols[i] &  (0x1 << (ppm-2))) << 1 |
+                       (symbols[i] & ((0x1 << (ppm-2)) - 1)) );
+      }
+
+      for (size_t block_count = 0; block_count < symbols.size()/(4+rdd); block_count++)
+      {
+        reference_block(&symbols[(4+rdd)*block_count], ppm, rdd, block);
+
+        for (int cw_idx = 0; cw_idx < ppm; cw_idx++)
+        {
+          switch (rdd)
+          {
+            case 4:
+              block[cw_idx] = (block[cw_idx] & 128) | (block[cw_idx] & 64) | (block[cw_idx] & 32) >> 5 | (block[cw_idx] & 16) | (block[cw_idx] & 8) << 2 | (block[cw_idx] & 4) << 1 | (block[cw_idx] & 2) << 1 | (block[cw_idx] & 1) << 1;
+              break;
+            case 3:
+              block[cw_idx] = (block[cw_idx] & 64) | (block[cw_idx] & 32) | (block[cw_idx] & 16) >> 1 | (block[cw_idx] & 8) << 1 | (block[cw_idx] & 4) | (block[cw_idx] & 2) | (block[cw_idx] & 1);
+              break;
+            default:
+              break;
+          }
+          block[cw_idx] = block[cw_idx] & ((1 << (4+rdd)) - 1);
+        }
+
+        if (ppm == 8)
+        {
+          codewords.push_back(block[6]);
+          codewords.push_back(block[7]);
+          codewords.push_back(block[4]);
+          codewords.push_back(block[5]);
+        }
+        else if (ppm == 7)
+        {
+          codewords.push_back(block[6]);
+          codewords.push_back(block[4]);
+          codewords.push_back(block[5]);
+        }
+        else if (ppm == 6)
+        {
+          codewords.push_back(block[4]);
+          codewords.push_back(block[5]);
+        }
+        else if (ppm == 5)
+        {
+          codewords.push_back(block[4]);
+        }
+        codewords.push_back(block[2]);
+        codewords.push_back(block[3]);
+        codewords.push_back(block[0]);
+        codewords.push_back(block[1]);
+      }
+    }
+
+    static void
+    random_symbols(std::vector<unsigned short> &symbols, unsigned char ppm)
+    {
+      for (size_t i = 0; i < symbols.size(); i++) symbols[i] = rand() & ((1 << ppm) - 1);
+    }
+
+    void
+    qa_deinterleaver::t1_block_equivalence()
+    {
+      unsigned char expected[INTERLEAVER_BLOCK_SIZE];
+      unsigned char actual[INTERLEAVER_BLOCK_SIZE];
+
+      srand(0);
+      for (int ppm = 4; ppm <= 12; ppm++)
+      {
+        for (int rdd = 1; rdd <= 4; rdd++)
+        {
+          std::vector<unsigned short> symbols(TEST_BLOCKS*(4+rdd));
+          random_symbols(symbols, ppm);
+
+          for (size_t b = 0; b < TEST_BLOCKS; b++)
+          {
+            reference_block(&symbols[b*(4+rdd)], ppm, rdd, expected);
+            deinterleave_block(&symbols[b*(4+rdd)], ppm, rdd, actual);
+
+            for (int cw = 0; cw < ppm; cw++)
+            {
+              CPPUNIT_ASSERT_EQUAL((int)expected[cw], (int)actual[cw]);
+            }
+          }
+        }
+      }
+    }
+
+    void
+    qa_deinterleaver::t2_packet_order()
+    {
+      srand(1);
+      for (int ppm = 4; ppm <= 8; ppm++)
+      {
+        for (int rdd = 1; rdd <= 4; rdd++)
+        {
+          std::vector<unsigned short> symbols(TEST_BLOCKS*(4+rdd));
+          std::vector<unsigned char>  expected;
+          std::vector<unsigned char>  actual(TEST_BLOCKS*ppm);
+          random_symbols(symbols, ppm);
+
+          reference_deinterleave(symbols, expected, ppm, rdd);
+          size_t num_codewords = deinterleave_codewords(&symbols[0], symbols.size(), ppm, rdd, &actual[0]);
+
+          CPPUNIT_ASSERT_EQUAL(expected.size(), num_codewords);
+          CPPUNIT_ASSERT(expected == actual);
+        }
+      }
+    }
+
+    void
+    qa_deinterleaver::t3_round_trip()
+    {
+      unsigned char encode_table[16];
+      unsigned char decode_table[256];
+
+      srand(2);
+      for (int ppm = 4; ppm <= 12; ppm++)
+      {
+        for (int rdd = 1; rdd <= 4; rdd++)
+        {
+          std::vector<unsigned char>  nybbles(TEST_BLOCKS*ppm);
+          std::vector<unsigned char>  codewords(TEST_BLOCKS*ppm);
+          std::vector<unsigned short> symbols(TEST_BLOCKS*(4+rdd));
+          std::vector<unsigned char>  received(TEST_BLOCKS*ppm);
+
+          for (size_t i = 0; i < nybbles.size(); i++) nybbles[i] = rand() & 0x0F;
+
+          hamming_build_encode_table(encode_table, rdd);
+          hamming_build_table(decode_table, rdd);
+
+          hamming_encode(encode_table, &nybbles[0], &codewords[0], nybbles.size());
+          CPPUNIT_ASSERT_EQUAL(symbols.size(), interleave_codewords(&codewords[0], codewords.size(), ppm, rdd, &symbols[0]));
+
+          for (size_t i = 0; i < symbols.size(); i++) CPPUNIT_ASSERT(symbols[i] < (1 << ppm));
+
+          CPPUNIT_ASSERT_EQUAL(received.size(), deinterleave_codewords(&symbols[0], symbols.size(), ppm, rdd, &received[0]));
+
+          for (size_t i = 0; i < nybbles.size(); i++)
+          {
+            CPPUNIT_ASSERT_EQUAL((int)nybbles[i], (int)decode_table[received[i]]);
+          }
+        }
+      }
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
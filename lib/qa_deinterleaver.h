@@ -0,0 +1,48 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _QA_LORA_DEINTERLEAVER_H_
+#define _QA_LORA_DEINTERLEAVER_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr {
+  namespace lora {
+
+    class qa_deinterleaver : public CppUnit::TestCase
+    {
+    public:
+      CPPUNIT_TEST_SUITE(qa_deinterleaver);
+      CPPUNIT_TEST(t1_block_equivalence);
+      CPPUNIT_TEST(t2_packet_order);
+      CPPUNIT_TEST(t3_round_trip);
+      CPPUNIT_TEST_SUITE_END();
+
+    private:
+      void t1_block_equivalence();
+      void t2_packet_order();
+      void t3_round_trip();
+    };
+
+  } /* namespace lora */
+} /* namespace gr */
+
+#endif /* _QA_LORA_DEINTERLEAVER_H_ */
@@ -0,0 +1,111 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cstdlib>
+#include <gnuradio/blocks/vector_source_c.h>
+#include <lora/mod.h>
+#include <lora/demod.h>
+#include "qa_demod.h"
+#include "qa_flowgraph.h"
+
+#define QA_DEMOD_SYNC_WORD  0x12
+#define QA_DEMOD_BETA       25.0
+#define QA_DEMOD_PAD_CHIRPS 8       // Silence after each packet, past the squelch tail and the demodulator's unprocessed history
+
+namespace gr {
+  namespace lora {
+
+    // Modulates one packet of demodulator-domain symbols, whose first PHY_HEADER_SYMBOLS are reduced rate,
+    // at oversampling samples per chip, followed by enough silence for a demodulator to finish it
+    static std::vector<gr_complex>
+    qa_modulate(short sf, unsigned short oversampling, std::vector<uint16_t> symbols)
+    {
+      size_t fft_size = 1 << sf;
+      gr::top_block_sptr              tb   = gr::make_top_block("qa_modulate");
+      mod::sptr                       mod  = mod::make(sf, QA_DEMOD_SYNC_WORD, true, oversampling);
+      gr::blocks::vector_sink_c::sptr sink = gr::blocks::vector_sink_c::make();
+
+      for (size_t i = 0; i < PHY_HEADER_SYMBOLS; i++) symbols[i] <<= 2;
+
+      tb->connect(mod, 0, sink, 0);
+      mod->_post(pmt::mp("in"), pmt::cons(pmt::make_dict(), pmt::init_u16vector(symbols.size(), symbols)));
+
+      size_t num_samples = ((8 + 2 + 2 + symbols.size())*fft_size + fft_size/4)*oversampling;
+      qa_run_until(tb, boost::bind(qa_has_samples, sink, num_samples));
+
+      std::vector<gr_complex> samples = sink->data();
+      samples.resize(num_samples + QA_DEMOD_PAD_CHIRPS*fft_size*oversampling, gr_complex(0, 0));
+
+      return samples;
+    }
+
+    // Demodulates samples taken at oversampling samples per chip and returns the first packet's symbols
+    static std::vector<uint16_t>
+    qa_demodulate(short sf, unsigned short oversampling, const std::vector<gr_complex> &samples)
+    {
+      gr::top_block_sptr                tb    = gr::make_top_block("qa_demodulate");
+      gr::blocks::vector_source_c::sptr src   = gr::blocks::vector_source_c::make(samples, false);
+      demod::sptr                       demod = demod::make(sf, false, QA_DEMOD_BETA, 1, false, oversampling);
+      gr::blocks::message_debug::sptr   dbg   = gr::blocks::message_debug::make();
+
+      tb->connect(src, 0, demod, 0);
+      tb->msg_connect(demod, "out", dbg, "store");
+
+      std::vector<uint16_t> symbols;
+      if (!qa_run_until(tb, boost::bind(qa_has_messages, dbg, 1))) return symbols;
+
+      size_t num_symbols(0);
+      const uint16_t *demodulated = pmt::u16vector_elements(pmt::cdr(dbg->get_message(0)), num_symbols);
+      symbols.assign(demodulated, demodulated + num_symbols);
+
+      return symbols;
+    }
+
+    void
+    qa_demod::t1_oversampling()
+    {
+      srand(0);
+      for (short sf = 7; sf <= 9; sf++)
+      {
+        std::vector<uint8_t> payload(16);
+        for (size_t i = 0; i < payload.size(); i++) payload[i] = rand();
+
+        std::vector<uint16_t> encoded  = qa_encode(sf, 4, false, false, true, payload);
+        std::vector<uint16_t> critical = qa_demodulate(sf, 1, qa_modulate(sf, 1, encoded));
+
+        // The squelch trips a symbol into the trailing silence, so only the packet's own symbols are compared
+        CPPUNIT_ASSERT(critical.size() >= encoded.size());
+        critical.resize(encoded.size());
+        CPPUNIT_ASSERT(critical == encoded);
+
+        for (unsigned short oversampling = 2; oversampling <= 4; oversampling *= 2)
+        {
+          std::vector<uint16_t> oversampled = qa_demodulate(sf, oversampling, qa_modulate(sf, oversampling, encoded));
+
+          CPPUNIT_ASSERT(oversampled.size() >= critical.size());
+          oversampled.resize(critical.size());
+          CPPUNIT_ASSERT(oversampled == critical);
+        }
+      }
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
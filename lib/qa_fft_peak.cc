@@ -0,0 +1,98 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <vector>
+#include <cstdlib>
+#include "qa_fft_peak.h"
+#include "fft_peak.h"
+#include "reference_kernels.h"
+
+namespace gr {
+  namespace lora {
+
+    typedef std::complex<float> sample_t;
+
+    // A dechirped symbol: a peak in one bin over unit-power noise
+    static void
+    random_spectrum(std::vector<sample_t> &fft_result)
+    {
+      for (size_t i = 0; i < fft_result.size(); i++)
+      {
+        fft_result[i] = sample_t(rand()/(float)RAND_MAX - 0.5f, rand()/(float)RAND_MAX - 0.5f);
+      }
+      fft_result[rand() % fft_result.size()] *= 8.0f;
+    }
+
+    void
+    qa_fft_peak::t1_peak_and_power()
+    {
+      srand(0);
+      for (int sf = 6; sf <= 12; sf++)
+      {
+        for (int fft_factor = 1; fft_factor <= 4; fft_factor *= 2)
+        {
+          size_t n = fft_factor << sf;
+          std::vector<sample_t> fft_result(n);
+          std::vector<float>    mag(n);
+
+          for (int trial = 0; trial < 16; trial++)
+          {
+            float  expected_peak, total_power;
+            double expected_total = 0;
+
+            random_spectrum(fft_result);
+            unsigned short expected = reference_argmax(&fft_result[0], n, expected_peak);
+            uint32_t       actual   = fft_peak(&fft_result[0], &mag[0], n, total_power);
+
+            for (size_t i = 0; i < n; i++)
+            {
+              CPPUNIT_ASSERT_DOUBLES_EQUAL(std::norm(fft_result[i]), mag[i], 1e-6*mag[i]);
+              expected_total += mag[i];
+            }
+
+            CPPUNIT_ASSERT_EQUAL((uint32_t)expected, actual);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(expected_peak, mag[actual], 1e-6*expected_peak);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(expected_total, total_power, 1e-4*expected_total);
+          }
+        }
+      }
+    }
+
+    void
+    qa_fft_peak::t2_ties()
+    {
+      std::vector<sample_t> fft_result(128, sample_t(0, 0));
+      std::vector<float>    mag(128);
+      float total_power;
+
+      // A silent spectrum peaks at bin 0
+      CPPUNIT_ASSERT_EQUAL((uint32_t)0, fft_peak(&fft_result[0], &mag[0], fft_result.size(), total_power));
+      CPPUNIT_ASSERT_EQUAL(0.0f, total_power);
+
+      // Equal peaks resolve to the lower bin
+      fft_result[21] = sample_t(1, 0);
+      fft_result[99] = sample_t(0, 1);
+      CPPUNIT_ASSERT_EQUAL((uint32_t)21, fft_peak(&fft_result[0], &mag[0], fft_result.size(), total_power));
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(2.0, total_power, 1e-6);
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
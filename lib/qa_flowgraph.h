@@ -0,0 +1,127 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _QA_LORA_FLOWGRAPH_H_
+#define _QA_LORA_FLOWGRAPH_H_
+
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <gnuradio/top_block.h>
+#include <gnuradio/blocks/message_debug.h>
+#include <gnuradio/blocks/vector_sink_c.h>
+#include <lora/encode.h>
+#include <lora/decode.h>
+#include "phy_header.h"
+
+#define QA_TIMEOUT_MS 5000   // Longest a block-level case waits for its flowgraph
+
+namespace gr {
+  namespace lora {
+
+    /*
+     * Helpers for the block-level cases, which drive blocks through their
+     * public make() and message ports.  Each flowgraph runs until the
+     * case's condition holds, then is stopped, since message-only and idle
+     * source blocks never finish on their own.
+     */
+
+    typedef boost::function<bool ()> qa_condition;
+
+    // Starts tb, waits up to QA_TIMEOUT_MS for done, and stops it; returns whether done held
+    inline bool
+    qa_run_until(gr::top_block_sptr tb, qa_condition done)
+    {
+      tb->start();
+      for (int ms = 0; ms < QA_TIMEOUT_MS && !done(); ms++)
+      {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+      }
+
+      bool finished = done();
+      tb->stop();
+      tb->wait();
+
+      return finished;
+    }
+
+    inline bool
+    qa_has_messages(gr::blocks::message_debug::sptr dbg, int num_messages)
+    {
+      return dbg->num_messages() >= num_messages;
+    }
+
+    inline bool
+    qa_has_samples(gr::blocks::vector_sink_c::sptr sink, size_t num_samples)
+    {
+      return sink->data().size() >= num_samples;
+    }
+
+    // A decoder has either published a frame or dropped one on its CRC
+    inline bool
+    qa_decoded(decode::sptr dec, gr::blocks::message_debug::sptr dbg)
+    {
+      return dbg->num_messages() > 0 || dec->crc_fail_count() > 0;
+    }
+
+    // Encodes payload and returns its symbols as the demodulator reports them, with the two always-zero LSBs
+    // the encoder adds to reduced-rate symbols (the header block, or every symbol with LDR) shifted back out
+    inline std::vector<uint16_t>
+    qa_encode(short sf, short cr, bool ldr, bool header, bool crc, const std::vector<uint8_t> &payload)
+    {
+      gr::top_block_sptr              tb  = gr::make_top_block("qa_encode");
+      encode::sptr                    enc = encode::make(sf, cr, ldr, header, crc);
+      gr::blocks::message_debug::sptr dbg = gr::blocks::message_debug::make();
+
+      tb->msg_connect(enc, "out", dbg, "store");
+      enc->_post(pmt::mp("in"), pmt::cons(pmt::make_dict(), pmt::init_u8vector(payload.size(), payload)));
+
+      std::vector<uint16_t> symbols;
+      if (!qa_run_until(tb, boost::bind(qa_has_messages, dbg, 1))) return symbols;
+
+      size_t num_symbols(0);
+      const uint16_t *encoded = pmt::u16vector_elements(pmt::cdr(dbg->get_message(0)), num_symbols);
+
+      symbols.assign(encoded, encoded + num_symbols);
+      for (size_t i = 0; i < num_symbols && (ldr || i < PHY_HEADER_SYMBOLS); i++) symbols[i] >>= 2;
+
+      return symbols;
+    }
+
+    // Hands symbols, with metadata meta, to dec and returns the message_debug block holding its output frames
+    inline gr::blocks::message_debug::sptr
+    qa_decode(decode::sptr dec, pmt::pmt_t meta, const std::vector<uint16_t> &symbols)
+    {
+      gr::top_block_sptr              tb  = gr::make_top_block("qa_decode");
+      gr::blocks::message_debug::sptr dbg = gr::blocks::message_debug::make();
+
+      tb->msg_connect(dec, "out", dbg, "store");
+      dec->_post(pmt::mp("in"), pmt::cons(meta, pmt::init_u16vector(symbols.size(), symbols)));
+
+      qa_run_until(tb, boost::bind(qa_decoded, dec, dbg));
+
+      return dbg;
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
+
+#endif /* _QA_LORA_FLOWGRAPH_H_ */
@@ -0,0 +1,124 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include "qa_hamming.h"
+#include "hamming.h"
+#include "reference_kernels.h"
+
+namespace gr {
+  namespace lora {
+
+    // Codeword the encoder sends for a nybble
+    static unsigned char
+    sent_codeword(unsigned char nybble, unsigned char rdd)
+    {
+      unsigned char p1 = reference_parity(nybble, 0x0D);
+      unsigned char p2 = reference_parity(nybble, 0x0B);
+      unsigned char p4 = reference_parity(nybble, 0x07);
+      unsigned char p8 = reference_parity(nybble | p1 << 7 | p2 << 6 | p4 << 4, 0xFF);
+      unsigned char cw = (p1 << 7) | (p2 << 6) | (p8 << 5) | (p4 << 4) | nybble;
+
+      if (rdd == 3) cw = ((cw >> 1) & 0x60) | (cw & 0x1F);
+
+      return cw & ((1 << (4+rdd)) - 1);
+    }
+
+    // The sent codeword rearranged into the Hamming order the deinterleaver hands the decoder
+    static unsigned char
+    valid_codeword(unsigned char nybble, unsigned char rdd)
+    {
+      unsigned char cw = sent_codeword(nybble, rdd);
+
+      switch (rdd)
+      {
+        case 4:
+          return (cw & 128) | (cw & 64) | (cw & 32) >> 5 | (cw & 16) | (cw & 8) << 2 | (cw & 4) << 1 | (cw & 2) << 1 | (cw & 1) << 1;
+        case 3:
+          return (cw & 64) | (cw & 32) | (cw & 16) >> 1 | (cw & 8) << 1 | (cw & 4) | (cw & 2) | (cw & 1);
+        default:
+          return cw;
+      }
+    }
+
+    void
+    qa_hamming::t1_bit_exact()
+    {
+      unsigned char table[256];
+
+      for (int rdd = 1; rdd <= 4; rdd++)
+      {
+        hamming_build_table(table, rdd);
+
+        for (int codeword = 0; codeword < 256; codeword++)
+        {
+          CPPUNIT_ASSERT_EQUAL((int)reference_decode(codeword, rdd), (int)(table[codeword] & 0x0F));
+        }
+      }
+    }
+
+    void
+    qa_hamming::t2_error_flag()
+    {
+      unsigned char table[256];
+
+      for (int rdd = 1; rdd <= 4; rdd++)
+      {
+        hamming_build_table(table, rdd);
+
+        for (int nybble = 0; nybble < 16; nybble++)
+        {
+          unsigned char codeword = valid_codeword(nybble, rdd);
+
+          CPPUNIT_ASSERT_EQUAL(nybble, (int)table[codeword]);
+
+          // The single parity bit at rdd 1 does not cover d3, so only rdd 2 and up see every single-bit error
+          for (int bit = 0; rdd > 1 && bit < 4+rdd; bit++)
+          {
+            CPPUNIT_ASSERT(table[codeword ^ (1 << bit)] & HAMMING_ERROR_FLAG);
+          }
+        }
+      }
+    }
+
+    void
+    qa_hamming::t3_encode_table()
+    {
+      unsigned char table[16];
+      unsigned char nybbles[32];
+      unsigned char codewords[32];
+
+      // Every nybble twice, with junk in the high bits the encoder must ignore
+      for (int i = 0; i < 32; i++) nybbles[i] = (i << 4) | (i & 0x0F);
+
+      for (int rdd = 1; rdd <= 4; rdd++)
+      {
+        hamming_build_encode_table(table, rdd);
+        hamming_encode(table, nybbles, codewords, 32);
+
+        for (int i = 0; i < 32; i++)
+        {
+          CPPUNIT_ASSERT_EQUAL((int)sent_codeword(i & 0x0F, rdd), (int)codewords[i]);
+        }
+      }
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
@@ -26,11 +26,33 @@
  */
 
 #include "qa_lora.h"
+#include "qa_hamming.h"
+#include "qa_deinterleaver.h"
+#include "qa_fft_peak.h"
+#include "qa_dechirp.h"
+#include "qa_phy_header.h"
+#include "qa_crc16.h"
+#include "qa_soft_decode.h"
+#include "qa_sync_offset.h"
+#include "qa_mod_queue.h"
+#include "qa_mod.h"
+#include "qa_demod.h"
 
 CppUnit::TestSuite *
 qa_lora::suite()
 {
   CppUnit::TestSuite *s = new CppUnit::TestSuite("lora");
+  s->addTest(gr::lora::qa_hamming::suite());
+  s->addTest(gr::lora::qa_deinterleaver::suite());
+  s->addTest(gr::lora::qa_fft_peak::suite());
+  s->addTest(gr::lora::qa_dechirp::suite());
+  s->addTest(gr::lora::qa_phy_header::suite());
+  s->addTest(gr::lora::qa_crc16::suite());
+  s->addTest(gr::lora::qa_soft_decode::suite());
+  s->addTest(gr::lora::qa_sync_offset::suite());
+  s->addTest(gr::lora::qa_mod_queue::suite());
+  s->addTest(gr::lora::qa_mod::suite());
+  s->addTest(gr::lora::qa_demod::suite());
 
   return s;
 }
@@ -0,0 +1,180 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <gnuradio/fft/fft.h>
+#include <lora/mod.h>
+#include "qa_mod.h"
+#include "qa_flowgraph.h"
+#include "pdu_keys.h"
+#include "dechirp.h"
+#include "fft_peak.h"
+
+#define QA_MOD_SF         7
+#define QA_MOD_SYNC_WORD  0x12
+
+namespace gr {
+  namespace lora {
+
+    // Output samples of one burst carrying num_symbols: preamble, 2 sync words, 2.25 SFD chirps and the payload
+    static size_t
+    burst_samples(size_t num_symbols, unsigned short oversampling)
+    {
+      size_t fft_size = 1 << QA_MOD_SF;
+      return ((8 + 2 + 2 + num_symbols)*fft_size + fft_size/4)*oversampling;
+    }
+
+    // Offsets of the tags in tags with key
+    static std::vector<uint64_t>
+    tag_offsets(const std::vector<gr::tag_t> &tags, pmt::pmt_t key)
+    {
+      std::vector<uint64_t> offsets;
+
+      for (size_t i = 0; i < tags.size(); i++)
+      {
+        if (pmt::eqv(tags[i].key, key)) offsets.push_back(tags[i].offset);
+      }
+
+      return offsets;
+    }
+
+    void
+    qa_mod::t1_burst_tags()
+    {
+      const size_t lengths[] = { 10, 3 };
+
+      for (unsigned short oversampling = 1; oversampling <= 2; oversampling++)
+      {
+        gr::top_block_sptr              tb   = gr::make_top_block("qa_mod");
+        mod::sptr                       mod  = mod::make(QA_MOD_SF, QA_MOD_SYNC_WORD, true, oversampling);
+        gr::blocks::vector_sink_c::sptr sink = gr::blocks::vector_sink_c::make();
+        pmt::pmt_t                      time = pmt::make_tuple(pmt::from_uint64(5), pmt::from_double(0.25));
+
+        tb->connect(mod, 0, sink, 0);
+
+        // Only the first packet asks for a transmit time
+        for (size_t p = 0; p < 2; p++)
+        {
+          std::vector<uint16_t> symbols(lengths[p]);
+          for (size_t i = 0; i < symbols.size(); i++) symbols[i] = (37*i + p) % (1 << QA_MOD_SF);
+
+          pmt::pmt_t meta = (p == 0) ? pmt::dict_add(pmt::make_dict(), TAG_TX_TIME, time) : pmt::make_dict();
+          mod->_post(pmt::mp("in"), pmt::cons(meta, pmt::init_u16vector(symbols.size(), symbols)));
+        }
+
+        size_t first = burst_samples(lengths[0], oversampling);
+        size_t total = first + burst_samples(lengths[1], oversampling);
+
+        CPPUNIT_ASSERT(qa_run_until(tb, boost::bind(qa_has_samples, sink, total)));
+
+        // Bursts are sent back to back, with no padding
+        std::vector<gr::tag_t> tags = sink->tags();
+        CPPUNIT_ASSERT_EQUAL(total, sink->data().size());
+
+        std::vector<uint64_t> sob  = tag_offsets(tags, TAG_TX_SOB);
+        std::vector<uint64_t> eob  = tag_offsets(tags, TAG_TX_EOB);
+        std::vector<uint64_t> when = tag_offsets(tags, TAG_TX_TIME);
+
+        CPPUNIT_ASSERT_EQUAL((size_t)2, sob.size());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0,         sob[0]);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)first,     sob[1]);
+
+        CPPUNIT_ASSERT_EQUAL((size_t)2, eob.size());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)first - 1, eob[0]);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)total - 1, eob[1]);
+
+        CPPUNIT_ASSERT_EQUAL((size_t)1, when.size());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0,         when[0]);
+
+        for (size_t i = 0; i < tags.size(); i++)
+        {
+          if (!pmt::eqv(tags[i].key, TAG_TX_TIME)) continue;
+
+          CPPUNIT_ASSERT_EQUAL((uint64_t)5, pmt::to_uint64(pmt::tuple_ref(tags[i].value, 0)));
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(0.25, pmt::to_double(pmt::tuple_ref(tags[i].value, 1)), 1e-9);
+        }
+      }
+    }
+
+    // Synthesizes one burst of symbols, and dechirps every chirp of it taken at chip rate; the preamble, sync words
+    // and payload must peak at their offsets, and the SFD downchirps at 0, with nearly all of their power in that bin
+    void
+    qa_mod::t2_nco_dechirp()
+    {
+      unsigned int num_symbols = 1 << QA_MOD_SF;
+      std::vector<std::complex<float> > upchirp, downchirp;
+      std::vector<float> mag(num_symbols);
+      gr::fft::fft_complex fft(num_symbols, true, 1);
+
+      build_chirps(num_symbols, upchirp, downchirp);
+
+      std::vector<uint16_t> symbols;
+      for (unsigned int i = 0; i < 24; i++) symbols.push_back((37*i + 5) % num_symbols);
+
+      // Chip offset and expected bin of each chirp: 8 preamble chirps, 2 sync words, 2 whole SFD downchirps, and the
+      // payload, which starts a quarter chirp later and is sent a quarter chirp ahead to make up for it
+      std::vector<size_t>       starts;
+      std::vector<unsigned int> bins;
+      for (unsigned int i = 0; i < 8; i++) { starts.push_back(i*num_symbols); bins.push_back(0); }
+      starts.push_back(8*num_symbols);  bins.push_back(8*((QA_MOD_SYNC_WORD & 0xF0) >> 4));
+      starts.push_back(9*num_symbols);  bins.push_back(8*(QA_MOD_SYNC_WORD & 0x0F));
+      starts.push_back(10*num_symbols); bins.push_back(0);
+      starts.push_back(11*num_symbols); bins.push_back(0);
+      for (size_t i = 0; i < symbols.size(); i++)
+      {
+        starts.push_back((12 + i)*num_symbols + num_symbols/4);
+        bins.push_back((symbols[i] + num_symbols/4) % num_symbols);
+      }
+
+      for (unsigned short oversampling = 1; oversampling <= 2; oversampling++)
+      {
+        gr::top_block_sptr              tb   = gr::make_top_block("qa_mod");
+        mod::sptr                       mod  = mod::make(QA_MOD_SF, QA_MOD_SYNC_WORD, true, oversampling);
+        gr::blocks::vector_sink_c::sptr sink = gr::blocks::vector_sink_c::make();
+
+        tb->connect(mod, 0, sink, 0);
+        mod->_post(pmt::mp("in"), pmt::cons(pmt::make_dict(), pmt::init_u16vector(symbols.size(), symbols)));
+
+        size_t total = burst_samples(symbols.size(), oversampling);
+        CPPUNIT_ASSERT(qa_run_until(tb, boost::bind(qa_has_samples, sink, total)));
+
+        // Every oversampling-th sample falls on the 1x chirp
+        std::vector<gr_complex> samples = sink->data();
+        std::vector<gr_complex> chips;
+        for (size_t i = 0; i < samples.size(); i += oversampling) chips.push_back(samples[i]);
+
+        for (size_t c = 0; c < starts.size(); c++)
+        {
+          const std::complex<float> *local = (c == 10 || c == 11) ? &upchirp[0] : &downchirp[0];
+          float total_power;
+
+          for (unsigned int i = 0; i < num_symbols; i++) fft.get_inbuf()[i] = chips[starts[c] + i]*local[i];
+          fft.execute();
+
+          uint32_t max_idx = fft_peak(fft.get_outbuf(), &mag[0], num_symbols, total_power);
+
+          CPPUNIT_ASSERT_EQUAL(bins[c], (unsigned int)max_idx);
+          CPPUNIT_ASSERT(mag[max_idx] > 0.99f*total_power);
+        }
+      }
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
@@ -0,0 +1,171 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include "qa_mod_queue.h"
+#include "mod_queue.h"
+
+namespace gr {
+  namespace lora {
+
+    // Queues a packet of num_segments segments, each tagged with the packet's sequence number in its offset
+    // Returns false if the queue refused it
+    static bool
+    queue_packet(mod_queue &queue, unsigned int num_segments, unsigned long &sequence)
+    {
+      mod_packet packet;
+
+      packet.num_segments = num_segments;
+      packet.num_samples  = num_segments;
+      packet.tx_time      = pmt::PMT_NIL;
+
+      bool queued = queue.begin(packet);
+      sequence = packet.sequence;
+      if (!queued) return false;
+
+      for (unsigned int i = 0; i < num_segments; i++)
+      {
+        chirp_segment segment;
+        segment.type   = CHIRP_UP;
+        segment.offset = packet.sequence;
+        segment.length = i;
+        queue.push(segment);
+      }
+
+      queue.publish(packet);
+      return true;
+    }
+
+    // Takes the next packet and all of its segments, checking they belong to it and arrive in order
+    static unsigned long
+    take_packet(mod_queue &queue, unsigned long &missed)
+    {
+      mod_packet    packet;
+      chirp_segment segment;
+
+      CPPUNIT_ASSERT(queue.pop_packet(packet, missed));
+
+      for (unsigned int i = 0; i < packet.num_segments; i++)
+      {
+        CPPUNIT_ASSERT(queue.pop_segment(segment));
+        CPPUNIT_ASSERT_EQUAL(packet.sequence, (unsigned long)segment.offset);
+        CPPUNIT_ASSERT_EQUAL(i, segment.length);
+      }
+
+      return packet.sequence;
+    }
+
+    void
+    qa_mod_queue::t1_capacity()
+    {
+      unsigned long sequence, missed;
+
+      // Segment capacity: exactly full is accepted, one over is not
+      mod_queue segments(10, 8);
+      CPPUNIT_ASSERT(segments.empty());
+      CPPUNIT_ASSERT(queue_packet(segments, 6, sequence));
+      CPPUNIT_ASSERT(!queue_packet(segments, 5, sequence));
+      CPPUNIT_ASSERT(queue_packet(segments, 4, sequence));
+      CPPUNIT_ASSERT(!queue_packet(segments, 1, sequence));
+      CPPUNIT_ASSERT_EQUAL(2ul, segments.dropped());
+
+      // Taking a packet frees its segments
+      take_packet(segments, missed);
+      CPPUNIT_ASSERT(queue_packet(segments, 6, sequence));
+
+      // Descriptor capacity, with segments to spare
+      mod_queue packets(100, 3);
+      for (int i = 0; i < 3; i++) CPPUNIT_ASSERT(queue_packet(packets, 1, sequence));
+      CPPUNIT_ASSERT(!queue_packet(packets, 1, sequence));
+      CPPUNIT_ASSERT_EQUAL(1ul, packets.dropped());
+
+      take_packet(packets, missed);
+      CPPUNIT_ASSERT(queue_packet(packets, 1, sequence));
+    }
+
+    void
+    qa_mod_queue::t2_drop_whole_packet()
+    {
+      mod_queue     queue(10, 8);
+      mod_packet    packet;
+      chirp_segment segment;
+      unsigned long sequence, missed;
+
+      CPPUNIT_ASSERT(queue_packet(queue, 7, sequence));
+      CPPUNIT_ASSERT(!queue_packet(queue, 4, sequence));   // Would fit in part
+      CPPUNIT_ASSERT(queue_packet(queue, 3, sequence));
+
+      // Nothing of the refused packet reaches the consumer
+      CPPUNIT_ASSERT_EQUAL(1ul, take_packet(queue, missed));
+      CPPUNIT_ASSERT_EQUAL(3ul, take_packet(queue, missed));
+      CPPUNIT_ASSERT(queue.empty());
+      CPPUNIT_ASSERT(!queue.pop_packet(packet, missed));
+      CPPUNIT_ASSERT(!queue.pop_segment(segment));
+
+      // A packet is invisible until published, though its segments are queued
+      packet.num_segments = 2;
+      packet.num_samples  = 2;
+      packet.tx_time      = pmt::PMT_NIL;
+      CPPUNIT_ASSERT(queue.begin(packet));
+      segment.type   = CHIRP_DOWN;
+      segment.offset = packet.sequence;
+      segment.length = 0;
+      queue.push(segment);
+      CPPUNIT_ASSERT(queue.empty());
+
+      segment.length = 1;
+      queue.push(segment);
+      queue.publish(packet);
+      CPPUNIT_ASSERT(!queue.empty());
+      CPPUNIT_ASSERT_EQUAL(packet.sequence, take_packet(queue, missed));
+    }
+
+    void
+    qa_mod_queue::t3_sequence_gaps()
+    {
+      mod_queue     queue(10, 8);
+      unsigned long sequence, missed;
+
+      CPPUNIT_ASSERT(queue_packet(queue, 8, sequence));
+      CPPUNIT_ASSERT_EQUAL(1ul, sequence);
+      CPPUNIT_ASSERT(!queue_packet(queue, 8, sequence));
+      CPPUNIT_ASSERT(!queue_packet(queue, 8, sequence));
+      CPPUNIT_ASSERT_EQUAL(3ul, sequence);
+
+      CPPUNIT_ASSERT_EQUAL(1ul, take_packet(queue, missed));
+      CPPUNIT_ASSERT_EQUAL(0ul, missed);
+
+      // Packets 2 and 3 were dropped
+      CPPUNIT_ASSERT(queue_packet(queue, 8, sequence));
+      CPPUNIT_ASSERT_EQUAL(4ul, take_packet(queue, missed));
+      CPPUNIT_ASSERT_EQUAL(2ul, missed);
+
+      // Back in sequence
+      CPPUNIT_ASSERT(queue_packet(queue, 2, sequence));
+      CPPUNIT_ASSERT(queue_packet(queue, 2, sequence));
+      CPPUNIT_ASSERT_EQUAL(5ul, take_packet(queue, missed));
+      CPPUNIT_ASSERT_EQUAL(0ul, missed);
+      CPPUNIT_ASSERT_EQUAL(6ul, take_packet(queue, missed));
+      CPPUNIT_ASSERT_EQUAL(0ul, missed);
+      CPPUNIT_ASSERT_EQUAL(2ul, queue.dropped());
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
@@ -0,0 +1,120 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include "qa_phy_header.h"
+#include "phy_header.h"
+
+namespace gr {
+  namespace lora {
+
+    // Payload length, code rate, CRC flag, and the five header nybbles they are sent as
+    static const unsigned char known_headers[][3+PHY_HEADER_NYBBLES] = {
+      { 0x0A, 1, 1,   0x0, 0xA, 0x3, 0x0, 0x9 },
+      { 0xFF, 4, 1,   0xF, 0xF, 0x9, 0x0, 0x8 },
+      { 0x01, 2, 0,   0x0, 0x1, 0x4, 0x0, 0x5 },
+      { 0x40, 3, 0,   0x4, 0x0, 0x6, 0x1, 0x0 },
+      { 0x00, 1, 0,   0x0, 0x0, 0x2, 0x0, 0x7 },
+    };
+
+    void
+    qa_phy_header::t1_checksum()
+    {
+      for (size_t h = 0; h < sizeof(known_headers)/sizeof(known_headers[0]); h++)
+      {
+        const unsigned char *nybbles = &known_headers[h][3];
+        unsigned char checksum = (nybbles[3] << 4) | nybbles[4];
+
+        CPPUNIT_ASSERT_EQUAL((int)checksum, (int)phy_header_checksum(nybbles));
+      }
+
+      // Every single-bit error in the three covered nybbles changes the checksum
+      for (int header = 0; header < (1 << 12); header++)
+      {
+        unsigned char nybbles[3] = { (unsigned char)(header >> 8), (unsigned char)((header >> 4) & 0x0F), (unsigned char)(header & 0x0F) };
+        unsigned char checksum = phy_header_checksum(nybbles);
+
+        for (int bit = 0; bit < 12; bit++)
+        {
+          unsigned char flipped[3] = { nybbles[0], nybbles[1], nybbles[2] };
+          flipped[bit / 4] ^= 1 << (bit % 4);
+
+          CPPUNIT_ASSERT(phy_header_checksum(flipped) != checksum);
+        }
+      }
+    }
+
+    void
+    qa_phy_header::t2_parse()
+    {
+      unsigned char payload_len, cr;
+      bool          crc;
+
+      for (size_t h = 0; h < sizeof(known_headers)/sizeof(known_headers[0]); h++)
+      {
+        unsigned char nybbles[PHY_HEADER_NYBBLES];
+        for (int i = 0; i < PHY_HEADER_NYBBLES; i++) nybbles[i] = known_headers[h][3+i];
+
+        CPPUNIT_ASSERT(phy_header_parse(nybbles, PHY_HEADER_NYBBLES, payload_len, cr, crc));
+        CPPUNIT_ASSERT_EQUAL((int)known_headers[h][0], (int)payload_len);
+        CPPUNIT_ASSERT_EQUAL((int)known_headers[h][1], (int)cr);
+        CPPUNIT_ASSERT_EQUAL((bool)known_headers[h][2], crc);
+
+        // Too few nybbles to hold a header
+        CPPUNIT_ASSERT(!phy_header_parse(nybbles, PHY_HEADER_NYBBLES-1, payload_len, cr, crc));
+
+        // Any checksum bit wrong
+        for (int bit = 0; bit < 5; bit++)
+        {
+          nybbles[3 + (bit < 4)] ^= (bit < 4) ? (1 << bit) : 1;
+          CPPUNIT_ASSERT(!phy_header_parse(nybbles, PHY_HEADER_NYBBLES, payload_len, cr, crc));
+          nybbles[3 + (bit < 4)] ^= (bit < 4) ? (1 << bit) : 1;
+        }
+      }
+
+      // Code rates outside 4/5 to 4/8 are rejected even with a matching checksum
+      for (int bad_cr = 0; bad_cr < 8; bad_cr += (bad_cr == 0) ? 5 : 1)
+      {
+        unsigned char nybbles[PHY_HEADER_NYBBLES] = { 0x1, 0x0, (unsigned char)(bad_cr << 1), 0, 0 };
+        unsigned char checksum = phy_header_checksum(nybbles);
+        nybbles[3] = checksum >> 4;
+        nybbles[4] = checksum & 0x0F;
+
+        CPPUNIT_ASSERT(!phy_header_parse(nybbles, PHY_HEADER_NYBBLES, payload_len, cr, crc));
+      }
+    }
+
+    void
+    qa_phy_header::t3_packet_symbols()
+    {
+      // Symbol counts from the LoRa time-on-air formula, 8 + ceil((8PL - 4SF + 28 + 16CRC) / 4(SF - 2DE)) * (CR + 4)
+      CPPUNIT_ASSERT_EQUAL(600u, phy_packet_symbols( 7, 255, 4, true,  false));
+      CPPUNIT_ASSERT_EQUAL( 28u, phy_packet_symbols( 7,  10, 1, true,  false));
+      CPPUNIT_ASSERT_EQUAL( 86u, phy_packet_symbols(10,  64, 2, false, false));
+      CPPUNIT_ASSERT_EQUAL( 28u, phy_packet_symbols(12,  20, 1, true,  true));
+      CPPUNIT_ASSERT_EQUAL(416u, phy_packet_symbols(12, 255, 4, true,  true));
+      CPPUNIT_ASSERT_EQUAL( 15u, phy_packet_symbols( 8,   0, 3, true,  false));
+
+      // A payload that fits in the header block adds no blocks
+      CPPUNIT_ASSERT_EQUAL(  8u, phy_packet_symbols( 9,   1, 2, false, false));
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
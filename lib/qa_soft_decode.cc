@@ -0,0 +1,129 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cstdlib>
+#include "qa_soft_decode.h"
+#include "qa_flowgraph.h"
+#include "pdu_keys.h"
+
+#define QA_SOFT_PAYLOAD_LEN  16
+#define QA_SOFT_CANDIDATES   2
+
+namespace gr {
+  namespace lora {
+
+    // Decodes symbols, with soft decisions if given, and returns the frame, or PMT_NIL if it was dropped
+    static pmt::pmt_t
+    decode_frame(short sf, short cr, const std::vector<uint16_t> &symbols, pmt::pmt_t meta)
+    {
+      decode::sptr dec = decode::make(sf, cr, false, false, true, QA_SOFT_PAYLOAD_LEN);
+      gr::blocks::message_debug::sptr dbg = qa_decode(dec, meta, symbols);
+
+      CPPUNIT_ASSERT_EQUAL(1ul, dec->crc_pass_count() + dec->crc_fail_count());
+
+      return dbg->num_messages() ? dbg->get_message(0) : pmt::PMT_NIL;
+    }
+
+    // Each interleaver block gets one symbol whose strongest candidate differs from the sent value in a
+    // single bit of its gray decoding, so the block deinterleaves to one codeword with one data bit in error.
+    // The sent value is the runner-up, only slightly weaker.  Every other symbol's strongest candidate is
+    // the sent value, with a weak random runner-up.  Hard decoding takes the strongest candidates, whose
+    // errors code rates 4/5 and 4/6 can only detect; soft decoding sees that the flipped bit is the least
+    // certain one and restores it at every code rate.
+    void
+    qa_soft_decode::t1_runner_up()
+    {
+      std::vector<uint8_t> payload(QA_SOFT_PAYLOAD_LEN);
+
+      srand(0);
+      for (short sf = 7; sf <= 12; sf++)
+      {
+        for (short cr = 1; cr <= 4; cr++)
+        {
+          for (size_t i = 0; i < payload.size(); i++) payload[i] = rand() & 0xFF;
+
+          std::vector<uint16_t> sent = qa_encode(sf, cr, false, false, true, payload);
+          CPPUNIT_ASSERT(sent.size() > PHY_HEADER_SYMBOLS);
+
+          std::vector<uint16_t> hard(sent);
+          std::vector<uint16_t> candidates(sent.size()*QA_SOFT_CANDIDATES);
+          std::vector<float>    magnitudes(sent.size()*QA_SOFT_CANDIDATES);
+          std::vector<float>    noise(sent.size(), 0.05f);
+
+          for (size_t block_start = 0; block_start < sent.size(); )
+          {
+            // The header block is sent at ppm=sf-2 and code rate 4/8
+            bool   header     = block_start < PHY_HEADER_SYMBOLS;
+            int    ppm        = header ? sf-2 : sf;
+            size_t block_len  = header ? PHY_HEADER_SYMBOLS : 4+cr;
+            int    bit        = rand() % ppm;
+
+            // Symbol s of a block carries bit s of every codeword in it.  Bits 0-2 are data bits d0-d2, which
+            // the parity of every code rate covers; the single parity bit at 4/5 misses d3, so a flipped d3
+            // would leave a valid codeword that no decoder can correct.
+            size_t wrong      = block_start + rand() % 3;
+
+            for (size_t i = block_start; i < block_start + block_len; i++)
+            {
+              uint16_t *cand = &candidates[i*QA_SOFT_CANDIDATES];
+              float    *mag  = &magnitudes[i*QA_SOFT_CANDIDATES];
+
+              if (i == wrong)
+              {
+                // Gray coding is linear, and (2 << bit) - 1 gray decodes to 1 << bit
+                hard[i] = sent[i] ^ ((2 << bit) - 1);
+                cand[0] = hard[i];  mag[0] = 1.0f;
+                cand[1] = sent[i];  mag[1] = 0.9f;
+              }
+              else
+              {
+                cand[0] = sent[i];  mag[0] = 1.0f;
+                cand[1] = (sent[i] + 1 + rand() % ((1 << ppm) - 1)) % (1 << ppm);
+                mag[1]  = 0.1f;
+              }
+            }
+
+            block_start += block_len;
+          }
+
+          pmt::pmt_t hard_frame = decode_frame(sf, cr, hard, pmt::make_dict());
+          if (cr <= 2) CPPUNIT_ASSERT(pmt::is_null(hard_frame));
+
+          pmt::pmt_t meta = pmt::make_dict();
+          meta = pmt::dict_add(meta, PDU_KEY_SOFT_CANDIDATES, pmt::from_long(QA_SOFT_CANDIDATES));
+          meta = pmt::dict_add(meta, PDU_KEY_SOFT_SYMBOLS,    pmt::init_u16vector(candidates.size(), candidates));
+          meta = pmt::dict_add(meta, PDU_KEY_SOFT_MAGNITUDES, pmt::init_f32vector(magnitudes.size(), magnitudes));
+          meta = pmt::dict_add(meta, PDU_KEY_SOFT_NOISE,      pmt::init_f32vector(noise.size(), noise));
+
+          pmt::pmt_t soft_frame = decode_frame(sf, cr, hard, meta);
+          CPPUNIT_ASSERT(!pmt::is_null(soft_frame));
+
+          size_t num_bytes(0);
+          const uint8_t *bytes = pmt::u8vector_elements(pmt::cdr(soft_frame), num_bytes);
+
+          CPPUNIT_ASSERT_EQUAL(payload.size(), num_bytes);
+          CPPUNIT_ASSERT(std::equal(payload.begin(), payload.end(), bytes));
+        }
+      }
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
@@ -0,0 +1,187 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cppunit/TestAssert.h>
+#include <cstdlib>
+#include <gnuradio/fft/fft.h>
+#include <gnuradio/fft/window.h>
+#include "qa_sync_offset.h"
+#include "sync_offset.h"
+#include "dechirp.h"
+#include "fft_peak.h"
+
+#define QA_SYNC_SF     7
+#define QA_SYNC_BETA   25.0    // The demodulator's default FFT window
+
+namespace gr {
+  namespace lora {
+
+    typedef std::complex<float> qa_sample_t;
+
+    // Upchirp (or downchirp) starting start chips in, shifted by cfo symbol bins
+    static void
+    synthesize(const std::vector<qa_sample_t> &chirp, unsigned int start, float cfo, std::vector<qa_sample_t> &out)
+    {
+      size_t n = chirp.size()/2;
+
+      out.resize(n);
+      for (size_t i = 0; i < n; i++)
+      {
+        out[i] = chirp[start + i] * std::polar(1.0f, (float)(2*M_PI*cfo*i/n));
+      }
+    }
+
+    // Multiplies signal by the local chirp, zero-pads it to fft_size_factor times its length, and returns
+    // the peak bin of its FFT, leaving every bin's power in mag
+    static uint32_t
+    dechirp_peak(const std::vector<qa_sample_t> &signal,
+                 const qa_sample_t *local,
+                 unsigned int fft_size_factor,
+                 std::vector<float> &mag)
+    {
+      size_t fft_size = signal.size()*fft_size_factor;
+      gr::fft::fft_complex fft(fft_size, true, 1);
+      float total_power;
+
+      std::fill(fft.get_inbuf(), fft.get_inbuf() + fft_size, qa_sample_t(0, 0));
+      for (size_t i = 0; i < signal.size(); i++) fft.get_inbuf()[i] = signal[i]*local[i];
+      fft.execute();
+
+      mag.resize(fft_size);
+      return fft_peak(fft.get_outbuf(), &mag[0], fft_size, total_power);
+    }
+
+    // Signed distance from a to b around a circle of circumference n
+    static float
+    wrapped_distance(float a, float b, float n)
+    {
+      return remainderf(b - a, n);
+    }
+
+    void
+    qa_sync_offset::t1_peak_offset()
+    {
+      unsigned int num_symbols = 1 << QA_SYNC_SF;
+      std::vector<qa_sample_t> upchirp, downchirp, windowed(num_symbols), signal;
+      std::vector<float> window = gr::fft::window::build(gr::fft::window::WIN_KAISER, num_symbols, QA_SYNC_BETA);
+      std::vector<float> mag;
+
+      build_chirps(num_symbols, upchirp, downchirp);
+      build_windowed_downchirps(&downchirp[0], &window[0], num_symbols, 1, &windowed[0]);
+
+      for (unsigned int fft_size_factor = 1; fft_size_factor <= 2; fft_size_factor++)
+      {
+        for (float cfo = 10.0f; cfo < 11.0f; cfo += 0.125f)
+        {
+          synthesize(upchirp, 0, cfo, signal);
+          uint32_t max_idx = dechirp_peak(signal, &windowed[0], fft_size_factor, mag);
+          float    offset  = peak_offset(&mag[0], mag.size(), max_idx);
+
+          CPPUNIT_ASSERT(offset >= -0.5f && offset <= 0.5f);
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(cfo*fft_size_factor, max_idx + offset, 0.02);
+        }
+      }
+    }
+
+    void
+    qa_sync_offset::t2_cfo_sto()
+    {
+      unsigned int num_symbols = 1 << QA_SYNC_SF;
+      std::vector<qa_sample_t> upchirp, downchirp, windowed(num_symbols), preamble, sfd;
+      std::vector<float> window = gr::fft::window::build(gr::fft::window::WIN_KAISER, num_symbols, QA_SYNC_BETA);
+      std::vector<float> mag;
+      const int stos[] = { 0, 3, -5, 20 };
+
+      build_chirps(num_symbols, upchirp, downchirp);
+      build_windowed_downchirps(&downchirp[0], &window[0], num_symbols, 1, &windowed[0]);
+
+      for (size_t s = 0; s < sizeof(stos)/sizeof(stos[0]); s++)
+      {
+        for (float cfo = -2.5f; cfo < 2.5f; cfo += 0.3f)
+        {
+          // Sampling starts sto chips into each chirp; as in the demodulator, the preamble is dechirped with the
+          // windowed downchirp and the SFD with the plain upchirp
+          unsigned int start = (num_symbols + stos[s]) % num_symbols;
+          synthesize(upchirp,   start, cfo, preamble);
+          synthesize(downchirp, start, cfo, sfd);
+
+          uint32_t preamble_idx = dechirp_peak(preamble, &windowed[0], 1, mag);
+          float    preamble_pos = preamble_idx + peak_offset(&mag[0], mag.size(), preamble_idx);
+          uint32_t sfd_idx      = dechirp_peak(sfd, &upchirp[0], 1, mag);
+          float    sfd_pos      = sfd_idx + peak_offset(&mag[0], mag.size(), sfd_idx);
+
+          float est_cfo, est_sto;
+          split_sync_offsets(preamble_pos, sfd_pos, num_symbols, est_cfo, est_sto);
+
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, wrapped_distance(cfo, est_cfo, num_symbols), 0.1);
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, wrapped_distance(stos[s], est_sto, num_symbols), 0.1);
+        }
+      }
+    }
+
+    // Runs the demodulator's tracking loop over data symbols carrying a fractional offset the preamble missed,
+    // rebuilding the compensated dechirp table whenever the tracked offset moves far enough
+    void
+    qa_sync_offset::t3_track_offset()
+    {
+      unsigned int num_symbols = 1 << QA_SYNC_SF;
+      std::vector<qa_sample_t> upchirp, downchirp, windowed(num_symbols), compensated(num_symbols), signal;
+      std::vector<float> window = gr::fft::window::build(gr::fft::window::WIN_KAISER, num_symbols, QA_SYNC_BETA);
+      std::vector<float> mag;
+      const float offsets[] = { 0.3f, -0.4f, 0.05f };
+
+      build_chirps(num_symbols, upchirp, downchirp);
+      build_windowed_downchirps(&downchirp[0], &window[0], num_symbols, 1, &windowed[0]);
+
+      srand(0);
+      for (size_t t = 0; t < sizeof(offsets)/sizeof(offsets[0]); t++)
+      {
+        float tracked = 0;
+        float applied = 0;
+        std::copy(windowed.begin(), windowed.end(), compensated.begin());
+
+        for (int symbol = 0; symbol < 64; symbol++)
+        {
+          unsigned int value = rand() % num_symbols;
+
+          synthesize(upchirp, value, offsets[t], signal);
+          uint32_t max_idx = dechirp_peak(signal, &compensated[0], 1, mag);
+
+          CPPUNIT_ASSERT_EQUAL(value, (unsigned int)max_idx);
+
+          tracked = track_offset_update(tracked, applied, symbol_residual(&mag[0], mag.size(), 1, max_idx, 0));
+
+          if (fabsf(tracked - applied) > CFO_REBUILD_THRESHOLD)
+          {
+            applied = tracked;
+            for (size_t i = 0; i < num_symbols; i++)
+            {
+              compensated[i] = windowed[i] * std::polar(1.0f, (float)(-2*M_PI*applied*i/num_symbols));
+            }
+          }
+        }
+
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(offsets[t], tracked, 0.02);
+        CPPUNIT_ASSERT(fabsf(applied - tracked) <= CFO_REBUILD_THRESHOLD);
+      }
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
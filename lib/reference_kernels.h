@@ -0,0 +1,168 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_REFERENCE_KERNELS_H
+#define INCLUDED_LORA_REFERENCE_KERNELS_H
+
+#include <complex>
+#include <cmath>
+#include <cstring>
+#include "deinterleaver.h"
+
+namespace gr {
+  namespace lora {
+
+    /*
+     * Straightforward versions of the kernels the blocks used before their
+     * table, transpose and VOLK rewrites.  Only the unit tests and the
+     * benchmark include this file; they check the new kernels against these
+     * and time one against the other.
+     */
+
+    inline unsigned char
+    reference_parity(unsigned char c, unsigned char bitmask)
+    {
+      unsigned char parity = 0;
+      unsigned char shiftme = c & bitmask;
+
+      for (int i = 0; i < 8; i++)
+      {
+        if (shiftme & 0x1) parity++;
+        shiftme = shiftme >> 1;
+      }
+
+      return parity % 2;
+    }
+
+    // The bit-loop decoder that the lookup tables replaced, one codeword at a time
+    inline unsigned char
+    reference_decode(unsigned char codeword, unsigned char rdd)
+    {
+      unsigned char p1 = 0, p2 = 0, p4 = 0, p8 = 0;
+      unsigned int num_set_bits;
+      int error_pos = 0;
+
+      switch (rdd) {
+        case 4:
+          p8 = reference_parity(codeword, 0xFE);
+        case 3:
+          p4 = reference_parity(codeword, 0x1E >> (4 - rdd));
+        case 2:
+          p2 = reference_parity(codeword, 0x66 >> (4 - rdd));
+        case 1:
+          p1 = reference_parity(codeword, 0xAA >> (4 - rdd));
+          break;
+      }
+
+      error_pos = -1;
+      if (p1 != 0) error_pos += 1;
+      if (p2 != 0) error_pos += 2;
+      if (p4 != 0) error_pos += 4;
+
+      if (rdd > 2)
+      {
+        num_set_bits = 0;
+        for (int bit_idx = 0; bit_idx < 8; bit_idx++)
+        {
+          if (codeword & (0x01 << bit_idx))
+          {
+            num_set_bits++;
+          }
+        }
+
+        if (error_pos >= 0 && num_set_bits < 6 && num_set_bits > 2)
+        {
+          codeword ^= (0x80 >> (4-rdd)) >> error_pos;
+        }
+      }
+
+      switch (rdd)
+      {
+        case 1:
+        case 2:
+          codeword = codeword & 0x0F;
+          break;
+        case 3:
+          codeword = (((codeword & 0x10) >> 1) | ((codeword & 0x04)) | ((codeword & 0x02)) | ((codeword & 0x01))) & 0x0F;
+          break;
+        case 4:
+          codeword = (((codeword & 0x20) >> 2) | ((codeword & 0x08) >> 1) | ((codeword & 0x04) >> 1) | ((codeword & 0x02) >> 1)) & 0x0F;
+          break;
+      }
+
+      return codeword;
+    }
+
+    // The bit-at-a-time diagonal walk that the transpose replaced, for one block of 4+rdd symbols
+    inline void
+    reference_block(const unsigned short *symbols,
+                    unsigned char ppm,
+                    unsigned char rdd,
+                    unsigned char *block)
+    {
+      int bit_offset = 0;
+      int bit_idx    = 0;
+
+      memset(block, 0, INTERLEAVER_BLOCK_SIZE*sizeof(unsigned char));
+
+      for (int bitcount = 0; bitcount < ppm*(4+rdd); bitcount++)
+      {
+        if (symbols[bitcount % (4+rdd)] & ((0x1 << (ppm-1)) >> ((bit_idx + bit_offset) % ppm)))
+        {
+          block[bitcount / (4+rdd)] |= 0x1 << (bitcount % (4+rdd));
+        }
+
+        if (bitcount % (4+rdd) == (4+rdd-1))
+        {
+          bit_idx = 0;
+          bit_offset++;
+        }
+        else
+        {
+          bit_idx++;
+        }
+      }
+    }
+
+    // The scalar argmax that fft_peak replaced
+    inline unsigned short
+    reference_argmax(const std::complex<float> *fft_result, size_t n, float &max_val)
+    {
+      float magsq;
+      unsigned short max_idx = 0;
+
+      max_val = pow(std::real(fft_result[0]), 2) + pow(std::imag(fft_result[0]), 2);
+      for (unsigned short i = 0; i < n; i++)
+      {
+        magsq = pow(std::real(fft_result[i]), 2) + pow(std::imag(fft_result[i]), 2);
+        if (magsq > max_val)
+        {
+          max_idx = i;
+          max_val = magsq;
+        }
+      }
+
+      return max_idx;
+    }
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_REFERENCE_KERNELS_H */
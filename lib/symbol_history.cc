@@ -0,0 +1,149 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 Bastille Networks.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cassert>
+#include "symbol_history.h"
+
+namespace gr {
+  namespace lora {
+
+    symbol_history::symbol_history(unsigned int capacity)
+      : d_values(capacity),
+        d_capacity(capacity),
+        d_min_queue(capacity),
+        d_max_queue(capacity)
+    {
+      assert(d_capacity > 0);
+      clear();
+    }
+
+    symbol_history::~symbol_history()
+    {
+    }
+
+    unsigned short
+    symbol_history::value_at(unsigned long count) const
+    {
+      return d_values[count % d_capacity];
+    }
+
+    void
+    symbol_history::push(unsigned short value)
+    {
+      // Retire the oldest entry from both queues before its slot is overwritten
+      if (d_count >= d_capacity)
+      {
+        unsigned long oldest = d_count - d_capacity;
+
+        if (d_min_len && d_min_queue[d_min_head] == oldest)
+        {
+          d_min_head = (d_min_head + 1) % d_capacity;
+          d_min_len--;
+        }
+        if (d_max_len && d_max_queue[d_max_head] == oldest)
+        {
+          d_max_head = (d_max_head + 1) % d_capacity;
+          d_max_len--;
+        }
+      }
+
+      d_values[d_count % d_capacity] = value;
+
+      // Entries dominated by the new value can never be the window min/max again
+      while (d_min_len && value_at(d_min_queue[(d_min_head + d_min_len - 1) % d_capacity]) >= value)
+      {
+        d_min_len--;
+      }
+      d_min_queue[(d_min_head + d_min_len++) % d_capacity] = d_count;
+
+      while (d_max_len && value_at(d_max_queue[(d_max_head + d_max_len - 1) % d_capacity]) <= value)
+      {
+        d_max_len--;
+      }
+      d_max_queue[(d_max_head + d_max_len++) % d_capacity] = d_count;
+
+      d_count++;
+      if (d_size < d_capacity) d_size++;
+    }
+
+    void
+    symbol_history::clear()
+    {
+      d_size  = 0;
+      d_count = 0;
+      d_min_head = d_min_len = 0;
+      d_max_head = d_max_len = 0;
+    }
+
+    unsigned short
+    symbol_history::operator[](unsigned int age) const
+    {
+      assert(age < d_size);
+      return value_at(d_count - 1 - age);
+    }
+
+    unsigned int
+    symbol_history::size() const
+    {
+      return d_size;
+    }
+
+    unsigned int
+    symbol_history::capacity() const
+    {
+      return d_capacity;
+    }
+
+    bool
+    symbol_history::full() const
+    {
+      return d_size == d_capacity;
+    }
+
+    unsigned short
+    symbol_history::min() const
+    {
+      assert(d_min_len);
+      return value_at(d_min_queue[d_min_head]);
+    }
+
+    unsigned short
+    symbol_history::max() const
+    {
+      assert(d_max_len);
+      return value_at(d_max_queue[d_max_head]);
+    }
+
+    // Equivalent to checking abs(newest - entry) <= tolerance for every entry in the window
+    bool
+    symbol_history::within_tolerance(unsigned int tolerance) const
+    {
+      if (d_size == 0) return false;
+
+      unsigned short newest = (*this)[0];
+      return ((unsigned int)(max() - newest) <= tolerance) && ((unsigned int)(newest - min()) <= tolerance);
+    }
+
+  } /* namespace lora */
+} /* namespace gr */
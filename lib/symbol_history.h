@@ -0,0 +1,73 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 Bastille Networks.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_SYMBOL_HISTORY_H
+#define INCLUDED_LORA_SYMBOL_HISTORY_H
+
+#include <vector>
+
+namespace gr {
+  namespace lora {
+
+    /*
+     * Fixed-capacity circular history of FFT argmax indices, newest first.
+     *
+     * Pushing overwrites the oldest entry once full.  Monotonic queues of the
+     * window minimum and maximum are maintained alongside the values, so checking
+     * that every entry lies within a tolerance of the newest is O(1) rather than
+     * a rescan of the window.
+     */
+    class symbol_history
+    {
+     private:
+      std::vector<unsigned short> d_values;
+      unsigned int  d_capacity;
+      unsigned int  d_size;
+      unsigned long d_count;        // Total number of pushes; entry k lives at d_values[k % d_capacity]
+
+      // Rings of push counts whose values are monotonically increasing (min) or decreasing (max)
+      std::vector<unsigned long> d_min_queue;
+      std::vector<unsigned long> d_max_queue;
+      unsigned int  d_min_head, d_min_len;
+      unsigned int  d_max_head, d_max_len;
+
+      unsigned short value_at(unsigned long count) const;
+
+     public:
+      symbol_history(unsigned int capacity);
+      ~symbol_history();
+
+      void push(unsigned short value);
+      void clear();
+
+      unsigned short operator[](unsigned int age) const;   // age 0 == newest
+      unsigned int   size() const;
+      unsigned int   capacity() const;
+      bool           full() const;
+
+      unsigned short min() const;
+      unsigned short max() const;
+      bool within_tolerance(unsigned int tolerance) const;
+    };
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_SYMBOL_HISTORY_H */
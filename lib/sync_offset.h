@@ -0,0 +1,101 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 Bastille Networks.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LORA_SYNC_OFFSET_H
+#define INCLUDED_LORA_SYNC_OFFSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cmath>
+#include <algorithm>
+
+#define CFO_TRACKING_GAIN     0.125f      // Loop gain applied to each data symbol's residual sub-bin offset
+#define CFO_REBUILD_THRESHOLD (1.0f/32)   // Tracked offset change, in symbol bins, that triggers a dechirp table rebuild
+
+namespace gr {
+  namespace lora {
+
+    /*
+     * Sub-bin synchronization estimates, from the bin powers fft_peak() leaves
+     * behind.  Offsets are in FFT bins unless noted; with an FFT size factor
+     * above 1 there are that many FFT bins per symbol bin.
+     */
+
+    // Fractional position of the peak at max_idx relative to that bin, in FFT bins, from the n bin powers in mag
+    // Fits a parabola through the log powers of the peak and its two neighbours; the windowed
+    // peak is close to Gaussian, for which this interpolation is exact
+    inline float
+    peak_offset(const float *mag, size_t n, uint32_t max_idx)
+    {
+      float left   = mag[(max_idx + n - 1) % n];
+      float centre = mag[max_idx];
+      float right  = mag[(max_idx + 1) % n];
+
+      if (left <= 0 || centre <= 0 || right <= 0) return 0;
+
+      left   = logf(left);
+      centre = logf(centre);
+      right  = logf(right);
+
+      float curvature = left - 2*centre + right;
+      if (curvature >= 0) return 0;
+
+      return std::max(-0.5f, std::min(0.5f, 0.5f*(left - right)/curvature));
+    }
+
+    // An upchirp's peak sits at CFO + STO and a downchirp's at CFO - STO, so the preamble and SFD peaks split them
+    // Positions and the carrier frequency offset are in symbol bins, the timing offset in chips; both wrap to +-num_symbols/4
+    inline void
+    split_sync_offsets(float preamble_pos,
+                       float sfd_pos,
+                       unsigned int num_symbols,
+                       float &cfo,
+                       float &sto)
+    {
+      cfo = remainderf((preamble_pos + sfd_pos)/2, num_symbols/2);
+      sto = remainderf((preamble_pos - sfd_pos)/2, num_symbols/2);
+    }
+
+    // Distance of the peak at max_idx from the nearest whole symbol bin, measured after compensation, in FFT bins
+    // ref_idx is the preamble's peak bin, which whole symbol bins are counted from
+    inline float
+    symbol_residual(const float *mag,
+                    size_t fft_size,
+                    unsigned int fft_size_factor,
+                    uint32_t max_idx,
+                    uint32_t ref_idx)
+    {
+      int whole = (fft_size + max_idx - ref_idx) % fft_size_factor;
+
+      return (whole > (int)fft_size_factor/2 ? whole - (int)fft_size_factor : whole) + peak_offset(mag, fft_size, max_idx);
+    }
+
+    // One step of the first-order loop that follows carrier drift over a packet, in symbol bins
+    // applied is the offset the symbol was dechirped with, and residual the symbol's remaining offset after it
+    inline float
+    track_offset_update(float tracked, float applied, float residual)
+    {
+      return tracked + CFO_TRACKING_GAIN*(applied + residual - tracked);
+    }
+
+  } // namespace lora
+} // namespace gr
+
+#endif /* INCLUDED_LORA_SYNC_OFFSET_H */
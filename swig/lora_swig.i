@@ -12,6 +12,8 @@
 #include "lora/decode.h"
 #include "lora/mod.h"
 #include "lora/encode.h"
+#include "lora/multi_sf_demod.h"
+#include "lora/channelizer.h"
 %}
 
 
@@ -23,3 +25,7 @@ GR_SWIG_BLOCK_MAGIC2(lora, decode);
 GR_SWIG_BLOCK_MAGIC2(lora, mod);
 %include "lora/encode.h"
 GR_SWIG_BLOCK_MAGIC2(lora, encode);
+%include "lora/multi_sf_demod.h"
+GR_SWIG_BLOCK_MAGIC2(lora, multi_sf_demod);
+%include "lora/channelizer.h"
+GR_SWIG_BLOCK_MAGIC2(lora, channelizer);